@@ -10,73 +10,38 @@
 template<GLenum T> class vertex_buffer_t: public gl::vertex_buffer_t {
 public:
   void generate() {
-    GLuint id;
-    glGenBuffers(1, &id);
-    set(id);
+    set(gl::generate(gl::object_t::buffer));
   }
   
   void bind() {
-    glBindBuffer(T, *this);
+    gl::bind_buffer(T, *this);
   }
 };
 
 class vertex_array_t: public gl::vertex_array_t {
 public:
   void generate() {
-    GLuint id;
-    glGenVertexArrays(1, &id);
-    set(id);
+    set(gl::generate(gl::object_t::vertex_array));
   }
   
   void bind() {
-    glBindVertexArray(*this);
+    gl::bind_vertex_array(*this);
   }
 };
 
 class shader_t: public gl::shader_t {
-  GLuint compile_shader(GLenum type, const char* src) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &src, NULL);
-    glCompileShader(shader);
-    int success;
-    char infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(shader, 512, NULL, infoLog);
-      std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-      return -1;
-    }
-    return shader;
-  }
-  
 public:
-  bool create(const char* vertex, const char* fragment) {
-    GLuint vertexShader = compile_shader(GL_VERTEX_SHADER, vertex);
-    if (vertexShader == -1)
-      return false;
-    GLuint fragmentShader = compile_shader(GL_FRAGMENT_SHADER, fragment);
-    if (fragmentShader == -1)
-      return false;
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    int success;
-    char infoLog[512];
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-      glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-      std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+  bool create(gl::pending_program_t &pending) {
+    if (!pending.wait()) {
+      std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << pending.error() << std::endl;
       return false;
     }
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    set(shaderProgram);
+    set(pending.release());
     return true;
   }
   
   void use() {
-    glUseProgram(*this);
+    gl::use_program(*this);
   }
 };
 
@@ -123,55 +88,76 @@ int main(void) {
     std::cout << "Failed to initialize GLAD" << std::endl;
     return -1;
   }
-  
-  shader_t shaderProgram;
-  if (!shaderProgram.create(vertexShaderSource, fragmentShaderSource))
-    return -1;
-  
-  float vertices[] = {
-     0.5f,  0.5f, 0.0f,
-     0.5f, -0.5f, 0.0f,
-    -0.5f, -0.5f, 0.0f,
-    -0.5f,  0.5f, 0.0f
-  };
-  unsigned int indices[] = {
-    0, 1, 3,
-    1, 2, 3
-  };
-  
-  vertex_buffer_t<GL_ARRAY_BUFFER> VBO;
-  vertex_buffer_t<GL_ELEMENT_ARRAY_BUFFER> EBO;
-  vertex_array_t VAO;
-  VAO.generate();
-  VBO.generate();
-  EBO.generate();
-  VAO.bind();
-  VBO.bind();
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-  EBO.bind();
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
-  
-  while (!glfwWindowShouldClose(window)) {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-      glfwSetWindowShouldClose(window, true);
+  gl::context().deletions.set_deferred(true);
+  gl::context().handles.enable();
+  // GL objects live in this scope so they are released before shutdown()
+  // deletes what is queued and pooled and the leak report runs at exit
+  {
+    gl::debug_output_t debug;
+    debug.install();
+    
+    gl::program_cache_t programCache("program_cache");
+    gl::shader_compiler_t compiler;
+    gl::pending_program_t pendingProgram = compiler.submit({
+      { GL_VERTEX_SHADER, vertexShaderSource },
+      { GL_FRAGMENT_SHADER, fragmentShaderSource }
+    }, &programCache);
     
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    float vertices[] = {
+       0.5f,  0.5f, 0.0f,
+       0.5f, -0.5f, 0.0f,
+      -0.5f, -0.5f, 0.0f,
+      -0.5f,  0.5f, 0.0f
+    };
+    unsigned int indices[] = {
+      0, 1, 3,
+      1, 2, 3
+    };
     
-    shaderProgram.use();
-    // glUseProgram(shaderProgram); // works too
+    vertex_buffer_t<GL_ARRAY_BUFFER> VBO;
+    vertex_buffer_t<GL_ELEMENT_ARRAY_BUFFER> EBO;
+    vertex_array_t VAO;
+    VAO.generate();
+    VBO.generate();
+    EBO.generate();
     VAO.bind();
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    gl::buffer_data(VBO, GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW, "quad");
+    gl::buffer_data(EBO, GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW, "quad");
+    gl::vertex_layout<gl::attrib<float, 3>>::apply();
+    gl::bind_buffer(GL_ARRAY_BUFFER, 0);
+    gl::bind_vertex_array(0);
     
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    // Buffers were set up while the driver compiled in the background
+    shader_t shaderProgram;
+    if (!shaderProgram.create(pendingProgram))
+      return -1;
+    
+    gl::frame_pacer_t pacer;
+    while (!glfwWindowShouldClose(window)) {
+      if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+      
+      glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      
+      shaderProgram.use();
+      // glUseProgram(shaderProgram); // works too
+      VAO.bind();
+      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+      
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+      pacer.end_frame();
+      gl::end_frame();
+      
+      gl::debug_message_t msg;
+      while (debug.poll(msg))
+        std::cout << "GL DEBUG: " << msg.text << std::endl;
+    }
   }
+  gl::shutdown();
   
   glfwDestroyWindow(window);
   glfwTerminate();
-  exit(EXIT_SUCCESS);
+  return EXIT_SUCCESS;
 }
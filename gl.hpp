@@ -14,83 +14,3591 @@
 #else
 #include <GL/gl.h>
 #endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+// After the standard headers so __GLIBC__ is defined; musl has no backtrace()
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#endif
 
 namespace gl {
   namespace helper {
-    template<void (*func)(GLuint)> struct ptr_deleter_t {
-      typedef GLuint pointer;
-      void operator()(GLuint id) { func(id); }
+    static bool has_version(GLint major, GLint minor) {
+      GLint have_major = 0, have_minor = 0;
+      glGetIntegerv(GL_MAJOR_VERSION, &have_major);
+      glGetIntegerv(GL_MINOR_VERSION, &have_minor);
+      return have_major > major || (have_major == major && have_minor >= minor);
+    }
+    
+    static bool has_extension(const char *name) {
+      GLint count = 0;
+      glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+      for (GLint i = 0; i < count; ++i) {
+        const char *ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (ext && !std::strcmp(ext, name))
+          return true;
+      }
+      return false;
+    }
+    
+    static std::uint64_t hash_bytes(const void *data, std::size_t size, std::uint64_t hash = 14695981039346656037ull) {
+      const unsigned char *bytes = static_cast<const unsigned char*>(data);
+      for (std::size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+      }
+      return hash;
+    }
+    
+    static std::uint64_t hash_string(const char *str, std::uint64_t hash = 14695981039346656037ull) {
+      std::size_t size = str ? std::strlen(str) : 0;
+      hash = hash_bytes(&size, sizeof size, hash);
+      return hash_bytes(str, size, hash);
+    }
+    
+    // Bounded lock-free queue; any number of threads may push, a single
+    // thread pops. Pushing into a full ring fails instead of blocking.
+    template<typename T, std::size_t N> class ring_t {
+      static_assert(N && !(N & (N - 1)), "ring_t size must be a power of two");
+      
+      struct cell_t {
+        std::atomic<std::size_t> sequence;
+        T value;
+      };
+      
+      cell_t cells[N];
+      std::atomic<std::size_t> head, tail;
+      
+    public:
+      ring_t(): head(0), tail(0) {
+        for (std::size_t i = 0; i < N; ++i)
+          cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      
+      ring_t(const ring_t&) = delete;
+      ring_t& operator =(const ring_t&) = delete;
+      
+      bool push(const T &value) {
+        std::size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+          cell_t &cell = cells[pos & (N - 1)];
+          std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+          std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+          if (!diff) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              cell.value = value;
+              cell.sequence.store(pos + 1, std::memory_order_release);
+              return true;
+            }
+          } else if (diff < 0)
+            return false;
+          else
+            pos = head.load(std::memory_order_relaxed);
+        }
+      }
+      
+      bool pop(T &value) {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        cell_t &cell = cells[pos & (N - 1)];
+        std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (seq != pos + 1)
+          return false;
+        value = cell.value;
+        tail.store(pos + 1, std::memory_order_relaxed);
+        cell.sequence.store(pos + N, std::memory_order_release);
+        return true;
+      }
+    };
+  }
+  
+  enum class object_t {
+    vertex_array,
+    buffer,
+    frame_buffer,
+    render_buffer,
+    texture,
+    program,
+    query,
+    count
+  };
+  
+  namespace helper {
+    static void delete_vertex_arrays(GLsizei n, const GLuint *ids) {
+      glDeleteVertexArrays(n, ids);
+    }
+    
+    static void delete_buffer_arrays(GLsizei n, const GLuint *ids) {
+      glDeleteBuffers(n, ids);
+    }
+    
+    static void delete_frame_buffers(GLsizei n, const GLuint *ids) {
+      glDeleteFramebuffers(n, ids);
+    }
+    
+    static void delete_render_buffers(GLsizei n, const GLuint *ids) {
+      glDeleteRenderbuffers(n, ids);
+    }
+    
+    static void delete_textures(GLsizei n, const GLuint *ids) {
+      glDeleteTextures(n, ids);
+    }
+    
+    static void delete_programs(GLsizei n, const GLuint *ids) {
+      for (GLsizei i = 0; i < n; ++i)
+        glDeleteProgram(ids[i]);
+    }
+    
+    static void delete_queries(GLsizei n, const GLuint *ids) {
+      glDeleteQueries(n, ids);
+    }
+    
+    static void delete_objects(object_t type, GLsizei n, const GLuint *ids) {
+      switch (type) {
+        case object_t::vertex_array:
+          delete_vertex_arrays(n, ids);
+          break;
+        case object_t::buffer:
+          delete_buffer_arrays(n, ids);
+          break;
+        case object_t::frame_buffer:
+          delete_frame_buffers(n, ids);
+          break;
+        case object_t::render_buffer:
+          delete_render_buffers(n, ids);
+          break;
+        case object_t::texture:
+          delete_textures(n, ids);
+          break;
+        case object_t::program:
+          delete_programs(n, ids);
+          break;
+        case object_t::query:
+          delete_queries(n, ids);
+          break;
+        default:
+          break;
+      }
+    }
+    
+    static void gen_vertex_arrays(GLsizei n, GLuint *ids) {
+      glGenVertexArrays(n, ids);
+    }
+    
+    static void gen_buffer_arrays(GLsizei n, GLuint *ids) {
+      glGenBuffers(n, ids);
+    }
+    
+    static void gen_frame_buffers(GLsizei n, GLuint *ids) {
+      glGenFramebuffers(n, ids);
+    }
+    
+    static void gen_render_buffers(GLsizei n, GLuint *ids) {
+      glGenRenderbuffers(n, ids);
+    }
+    
+    static void gen_textures(GLsizei n, GLuint *ids) {
+      glGenTextures(n, ids);
+    }
+    
+    static void gen_programs(GLsizei n, GLuint *ids) {
+      for (GLsizei i = 0; i < n; ++i)
+        ids[i] = glCreateProgram();
+    }
+    
+    static void gen_queries(GLsizei n, GLuint *ids) {
+      glGenQueries(n, ids);
+    }
+    
+    static void gen_objects(object_t type, GLsizei n, GLuint *ids) {
+      switch (type) {
+        case object_t::vertex_array:
+          gen_vertex_arrays(n, ids);
+          break;
+        case object_t::buffer:
+          gen_buffer_arrays(n, ids);
+          break;
+        case object_t::frame_buffer:
+          gen_frame_buffers(n, ids);
+          break;
+        case object_t::render_buffer:
+          gen_render_buffers(n, ids);
+          break;
+        case object_t::texture:
+          gen_textures(n, ids);
+          break;
+        case object_t::program:
+          gen_programs(n, ids);
+          break;
+        case object_t::query:
+          gen_queries(n, ids);
+          break;
+        default:
+          break;
+      }
+    }
+    
+    // Hands out names generated ahead of time in blocks of glGen*(n, ids).
+    // acquire() only touches the driver when the pool has run dry; top_up()
+    // is meant to run at a frame boundary so refills stay off the hot path.
+    class name_pool_t {
+      std::vector<GLuint> names;
+      object_t type;
+      GLsizei block;
+      std::size_t low_water;
+      bool active = false;
+      
+    public:
+      name_pool_t(object_t type = object_t::buffer, GLsizei block = 64, std::size_t low_water = 16): type(type), block(block), low_water(low_water) {}
+      
+      void configure(GLsizei block_size, std::size_t low) {
+        block = block_size > 0 ? block_size : 1;
+        low_water = low;
+      }
+      
+      void reserve(GLsizei n) {
+        if (n <= 0)
+          return;
+        std::size_t old = names.size();
+        names.resize(old + static_cast<std::size_t>(n));
+        gen_objects(type, n, names.data() + old);
+        active = true;
+      }
+      
+      GLuint acquire() {
+        if (names.empty())
+          reserve(block);
+        GLuint id = names.back();
+        names.pop_back();
+        return id;
+      }
+      
+      void top_up() {
+        if (active && names.size() < low_water)
+          reserve(block);
+      }
+      
+      void clear() {
+        if (!names.empty())
+          delete_objects(type, static_cast<GLsizei>(names.size()), names.data());
+        names.clear();
+        active = false;
+      }
+      
+      std::size_t size() const {
+        return names.size();
+      }
+    };
+    
+    // Collects names released by handles so they can be handed to the driver
+    // as one glDelete*(n, ids) per object type instead of one call each.
+    class deletion_queue_t {
+      std::vector<GLuint> pending[static_cast<std::size_t>(object_t::count)];
+      bool deferred = false;
+      
+    public:
+      bool is_deferred() const {
+        return deferred;
+      }
+      
+      void set_deferred(bool enable) {
+        if (!enable)
+          flush();
+        deferred = enable;
+      }
+      
+      void push(object_t type, GLuint id) {
+        if (!deferred) {
+          delete_objects(type, 1, &id);
+          return;
+        }
+        pending[static_cast<std::size_t>(type)].push_back(id);
+      }
+      
+      void flush() {
+        for (std::size_t i = 0; i < static_cast<std::size_t>(object_t::count); ++i) {
+          std::vector<GLuint> &ids = pending[i];
+          if (ids.empty())
+            continue;
+          delete_objects(static_cast<object_t>(i), static_cast<GLsizei>(ids.size()), ids.data());
+          ids.clear();
+        }
+      }
+      
+      std::size_t size() const {
+        std::size_t n = 0;
+        for (const std::vector<GLuint> &ids: pending)
+          n += ids.size();
+        return n;
+      }
+    };
+  }
+  
+  namespace helper {
+    // Shadows the objects currently bound on a context so redundant
+    // glBindBuffer/glBindVertexArray/glUseProgram calls can be skipped.
+    // Anything bound behind its back has to be followed by invalidate().
+    class state_cache_t {
+      enum {
+        array_buffer,
+        element_array_buffer,
+        copy_read_buffer,
+        copy_write_buffer,
+        pixel_pack_buffer,
+        pixel_unpack_buffer,
+        texture_buffer,
+        transform_feedback_buffer,
+        uniform_buffer,
+        draw_indirect_buffer,
+        dispatch_indirect_buffer,
+        shader_storage_buffer,
+        atomic_counter_buffer,
+        query_buffer,
+        buffer_target_count
+      };
+      
+      static const GLuint unknown = static_cast<GLuint>(-1);
+      
+      GLuint buffers[buffer_target_count];
+      GLuint vertex_array;
+      GLuint program;
+      std::size_t elided_count = 0;
+      
+      static int buffer_slot(GLenum target) {
+        switch (target) {
+          case GL_ARRAY_BUFFER:
+            return array_buffer;
+          case GL_ELEMENT_ARRAY_BUFFER:
+            return element_array_buffer;
+          case GL_COPY_READ_BUFFER:
+            return copy_read_buffer;
+          case GL_COPY_WRITE_BUFFER:
+            return copy_write_buffer;
+          case GL_PIXEL_PACK_BUFFER:
+            return pixel_pack_buffer;
+          case GL_PIXEL_UNPACK_BUFFER:
+            return pixel_unpack_buffer;
+          case GL_TEXTURE_BUFFER:
+            return texture_buffer;
+          case GL_TRANSFORM_FEEDBACK_BUFFER:
+            return transform_feedback_buffer;
+          case GL_UNIFORM_BUFFER:
+            return uniform_buffer;
+#ifdef GL_DRAW_INDIRECT_BUFFER
+          case GL_DRAW_INDIRECT_BUFFER:
+            return draw_indirect_buffer;
+#endif
+#ifdef GL_DISPATCH_INDIRECT_BUFFER
+          case GL_DISPATCH_INDIRECT_BUFFER:
+            return dispatch_indirect_buffer;
+#endif
+#ifdef GL_SHADER_STORAGE_BUFFER
+          case GL_SHADER_STORAGE_BUFFER:
+            return shader_storage_buffer;
+#endif
+#ifdef GL_ATOMIC_COUNTER_BUFFER
+          case GL_ATOMIC_COUNTER_BUFFER:
+            return atomic_counter_buffer;
+#endif
+#ifdef GL_QUERY_BUFFER
+          case GL_QUERY_BUFFER:
+            return query_buffer;
+#endif
+          default:
+            return -1;
+        }
+      }
+      
+    public:
+      state_cache_t() {
+        invalidate();
+      }
+      
+      void invalidate() {
+        for (GLuint &id: buffers)
+          id = unknown;
+        vertex_array = unknown;
+        program = unknown;
+      }
+      
+      void forget(object_t type, GLuint id) {
+        switch (type) {
+          case object_t::buffer:
+            for (GLuint &bound: buffers)
+              if (bound == id)
+                bound = unknown;
+            break;
+          case object_t::vertex_array:
+            if (vertex_array == id) {
+              vertex_array = unknown;
+              buffers[element_array_buffer] = unknown;
+            }
+            break;
+          case object_t::program:
+            if (program == id)
+              program = unknown;
+            break;
+          default:
+            break;
+        }
+      }
+      
+      void bind_buffer(GLenum target, GLuint id) {
+        int slot = buffer_slot(target);
+        if (slot >= 0) {
+          if (buffers[slot] == id) {
+            ++elided_count;
+            return;
+          }
+          buffers[slot] = id;
+        }
+        glBindBuffer(target, id);
+      }
+      
+      void bind_vertex_array(GLuint id) {
+        if (vertex_array == id) {
+          ++elided_count;
+          return;
+        }
+        vertex_array = id;
+        // The element array binding is part of the vertex array object
+        buffers[element_array_buffer] = unknown;
+        glBindVertexArray(id);
+      }
+      
+      void use_program(GLuint id) {
+        if (program == id) {
+          ++elided_count;
+          return;
+        }
+        program = id;
+        glUseProgram(id);
+      }
+      
+      std::size_t elided() const {
+        return elided_count;
+      }
+      
+      void reset_elided() {
+        elided_count = 0;
+      }
+    };
+  }
+  
+  namespace helper {
+    inline const char* object_name(object_t type) {
+      static const char *const names[] = { "vertex_array", "buffer", "frame_buffer", "render_buffer", "texture", "program", "query" };
+      return type < object_t::count ? names[static_cast<std::size_t>(type)] : "unknown";
+    }
+    
+    // Bytes of GPU storage per object and per caller-supplied category.
+    // Objects are sized through buffer_data(), texture_image_2d() and
+    // render_buffer_storage() (or resize() for anything else) and dropped
+    // when their handle releases the name.
+    class memory_tracker_t {
+    public:
+      struct allocation_t {
+        object_t type;
+        GLuint id;
+        std::size_t bytes;
+        const char *category;
+      };
+      
+      struct category_t {
+        const char *name;
+        std::size_t live, peak, objects;
+      };
+      
+    private:
+      struct entry_t {
+        std::size_t bytes = 0;
+        const char *category = nullptr;
+        std::vector<std::size_t> levels;
+      };
+      
+      std::unordered_map<std::uint64_t, entry_t> entries;
+      std::unordered_map<std::string, category_t> categories;
+      std::size_t live_bytes = 0, peak_bytes = 0;
+      
+      static std::uint64_t key(object_t type, GLuint id) {
+        return (std::uint64_t(type) << 32) | id;
+      }
+      
+      category_t& category(const char *name) {
+        auto found = categories.find(name);
+        if (found == categories.end()) {
+          found = categories.emplace(name, category_t{nullptr, 0, 0, 0}).first;
+          found->second.name = found->first.c_str();
+        }
+        return found->second;
+      }
+      
+      void adjust(entry_t &entry, std::size_t bytes) {
+        category_t &cat = category(entry.category);
+        live_bytes = live_bytes - entry.bytes + bytes;
+        cat.live = cat.live - entry.bytes + bytes;
+        entry.bytes = bytes;
+        if (live_bytes > peak_bytes)
+          peak_bytes = live_bytes;
+        if (cat.live > cat.peak)
+          cat.peak = cat.live;
+      }
+      
+      entry_t& lookup(object_t type, GLuint id, const char *tag) {
+        entry_t &entry = entries[key(type, id)];
+        if (!tag)
+          tag = entry.category ? entry.category : "untagged";
+        // Entries keep the tracker's own copy of the name, never the
+        // caller's string, which may not outlive the call
+        if (!entry.category) {
+          category_t &cat = category(tag);
+          entry.category = cat.name;
+          ++cat.objects;
+        } else if (std::strcmp(entry.category, tag) != 0) {
+          // Retagged: move the bytes over to the new category
+          std::size_t bytes = entry.bytes;
+          adjust(entry, 0);
+          --category(entry.category).objects;
+          category_t &cat = category(tag);
+          entry.category = cat.name;
+          ++cat.objects;
+          adjust(entry, bytes);
+        }
+        return entry;
+      }
+      
+    public:
+      // Sets the whole size of an object, e.g. after glBufferData
+      void resize(object_t type, GLuint id, std::size_t bytes, const char *tag = nullptr) {
+        if (!id)
+          return;
+        entry_t &entry = lookup(type, id, tag);
+        entry.levels.clear();
+        adjust(entry, bytes);
+      }
+      
+      // Sets the size of one image (mip level or cube face) of an object
+      void resize_image(object_t type, GLuint id, std::size_t image, std::size_t bytes, const char *tag = nullptr) {
+        if (!id)
+          return;
+        entry_t &entry = lookup(type, id, tag);
+        if (entry.levels.size() <= image)
+          entry.levels.resize(image + 1, 0);
+        std::size_t total = entry.bytes - entry.levels[image] + bytes;
+        entry.levels[image] = bytes;
+        adjust(entry, total);
+      }
+      
+      void forget(object_t type, GLuint id) {
+        auto found = entries.find(key(type, id));
+        if (found == entries.end())
+          return;
+        adjust(found->second, 0);
+        --category(found->second.category).objects;
+        entries.erase(found);
+      }
+      
+      std::size_t live() const {
+        return live_bytes;
+      }
+      
+      std::size_t peak() const {
+        return peak_bytes;
+      }
+      
+      std::size_t bytes(object_t type, GLuint id) const {
+        auto found = entries.find(key(type, id));
+        return found == entries.end() ? 0 : found->second.bytes;
+      }
+      
+      // Categories by live bytes, largest first
+      std::vector<category_t> by_category() const {
+        std::vector<category_t> result;
+        for (const auto &entry: categories)
+          result.push_back(entry.second);
+        std::sort(result.begin(), result.end(), [](const category_t &a, const category_t &b) {
+          return a.live > b.live;
+        });
+        return result;
+      }
+      
+      std::vector<allocation_t> largest(std::size_t n) const {
+        std::vector<allocation_t> result;
+        result.reserve(entries.size());
+        for (const auto &entry: entries)
+          result.push_back(allocation_t{static_cast<object_t>(entry.first >> 32), static_cast<GLuint>(entry.first), entry.second.bytes, entry.second.category});
+        auto larger = [](const allocation_t &a, const allocation_t &b) {
+          return a.bytes > b.bytes;
+        };
+        if (result.size() > n) {
+          std::partial_sort(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(n), result.end(), larger);
+          result.resize(n);
+        } else
+          std::sort(result.begin(), result.end(), larger);
+        return result;
+      }
+      
+      void print(std::FILE *out = stdout, std::size_t n = 10) const {
+        std::fprintf(out, "gpu memory: %.2f MiB live, %.2f MiB peak\n", live_bytes / 1048576.0, peak_bytes / 1048576.0);
+        for (const category_t &cat: by_category())
+          std::fprintf(out, "  %-24s %10.2f MiB live %10.2f MiB peak %6zu objects\n", cat.name, cat.live / 1048576.0, cat.peak / 1048576.0, cat.objects);
+        for (const allocation_t &a: largest(n))
+          std::fprintf(out, "  %-13s %6u %10.2f MiB  %s\n", object_name(a.type), a.id, a.bytes / 1048576.0, a.category);
+      }
+    };
+    
+    // Debug registry of the names a context has handed out. While enabled
+    // it keeps the call stack each live name was generated from, so names
+    // still alive at shutdown can be traced back to their owner, and flags
+    // names released twice (e.g. by two handles sharing one name) before
+    // the driver hands them out again. Stacks are only captured where
+    // backtrace() is available.
+    class handle_registry_t {
+    public:
+      struct record_t {
+        object_t type;
+        GLuint id;
+        std::vector<void*> stack;
+      };
+      
+    private:
+      std::unordered_map<std::uint64_t, std::vector<void*>> live;
+      std::unordered_set<std::uint64_t> released;
+      std::vector<record_t> double_releases;
+      int depth = 16;
+      bool enabled = false;
+      
+      static std::uint64_t key(object_t type, GLuint id) {
+        return (std::uint64_t(type) << 32) | id;
+      }
+      
+      void capture(std::vector<void*> &stack) const {
+#if defined(__GLIBC__) || defined(__APPLE__)
+        stack.resize(static_cast<std::size_t>(depth));
+        int n = backtrace(stack.data(), depth);
+        stack.resize(n > 0 ? static_cast<std::size_t>(n) : 0);
+#else
+        (void)stack;
+#endif
+      }
+      
+      static void print_stack(std::FILE *out, const std::vector<void*> &stack) {
+#if defined(__GLIBC__) || defined(__APPLE__)
+        // Skip capture() and the context frames that called it
+        const int skip = 2;
+        int n = static_cast<int>(stack.size());
+        if (n <= skip)
+          return;
+        char **symbols = backtrace_symbols(stack.data() + skip, n - skip);
+        for (int i = 0; i < n - skip; ++i)
+          std::fprintf(out, "      %s\n", symbols ? symbols[i] : "?");
+        std::free(symbols);
+#else
+        (void)out;
+        (void)stack;
+#endif
+      }
+      
+    public:
+      void enable(bool on = true, int stack_depth = 16) {
+        enabled = on;
+        depth = stack_depth > 0 ? stack_depth : 1;
+        if (!on) {
+          live.clear();
+          released.clear();
+        }
+      }
+      
+      bool is_enabled() const {
+        return enabled;
+      }
+      
+      void created(object_t type, GLuint id) {
+        if (!enabled || !id)
+          return;
+        std::uint64_t k = key(type, id);
+        released.erase(k);
+        auto inserted = live.emplace(k, std::vector<void*>());
+        if (inserted.second)
+          capture(inserted.first->second);
+      }
+      
+      // Handles register the names they adopt (e.g. from a raw glGen*
+      // followed by set()), so a name the driver reuses starts out live
+      // again. Names the registry never saw at all, such as ones generated
+      // before enable(), are let through silently.
+      void destroyed(object_t type, GLuint id) {
+        if (!enabled || !id)
+          return;
+        std::uint64_t k = key(type, id);
+        auto found = live.find(k);
+        if (found != live.end()) {
+          live.erase(found);
+          released.insert(k);
+        } else if (released.count(k)) {
+          double_releases.push_back(record_t{type, id, std::vector<void*>()});
+          capture(double_releases.back().stack);
+        }
+      }
+      
+      std::size_t live_count() const {
+        return live.size();
+      }
+      
+      std::vector<record_t> leaks() const {
+        std::vector<record_t> result;
+        for (const auto &entry: live)
+          result.push_back(record_t{static_cast<object_t>(entry.first >> 32), static_cast<GLuint>(entry.first), entry.second});
+        return result;
+      }
+      
+      const std::vector<record_t>& double_released() const {
+        return double_releases;
+      }
+      
+      // Prints every live name and every double release with its stack and
+      // returns how many were reported
+      std::size_t report(std::FILE *out = stderr) const {
+        for (const auto &entry: live) {
+          std::fprintf(out, "gl: leaked %s %u, generated at:\n", object_name(static_cast<object_t>(entry.first >> 32)), static_cast<GLuint>(entry.first));
+          print_stack(out, entry.second);
+        }
+        for (const record_t &record: double_releases) {
+          std::fprintf(out, "gl: %s %u released twice, second release at:\n", object_name(record.type), record.id);
+          print_stack(out, record.stack);
+        }
+        return live.size() + double_releases.size();
+      }
     };
+  }
+  
+  class context_t {
+    helper::name_pool_t pools[static_cast<std::size_t>(object_t::count)];
+    
+  public:
+    helper::deletion_queue_t deletions;
+    helper::state_cache_t state;
+    helper::memory_tracker_t memory;
+    helper::handle_registry_t handles;
+    
+    context_t() {
+      for (std::size_t i = 0; i < static_cast<std::size_t>(object_t::count); ++i)
+        pools[i] = helper::name_pool_t(static_cast<object_t>(i));
+    }
+    
+    // Names still live when a tracked context goes away are leaks. Nothing
+    // is deleted here, the GL context is usually gone by then; call
+    // shutdown() first.
+    ~context_t() {
+      if (handles.is_enabled())
+        handles.report();
+    }
+    
+    helper::name_pool_t& names(object_t type) {
+      return pools[static_cast<std::size_t>(type)];
+    }
     
-    static void delete_vertex_array(GLuint id) {
-      glDeleteVertexArrays(1, &id);
+    GLuint generate(object_t type) {
+      GLuint id = type == object_t::program ? glCreateProgram() : names(type).acquire();
+      handles.created(type, id);
+      return id;
     }
     
-    static void delete_buffer_array(GLuint id) {
-      glDeleteBuffers(1, &id);
+    void release(object_t type, GLuint id) {
+      handles.destroyed(type, id);
+      state.forget(type, id);
+      memory.forget(type, id);
+      deletions.push(type, id);
     }
     
-    static void delete_frame_buffer(GLuint id) {
-      glDeleteFramebuffers(1, &id);
+    // Block variants for handle arrays: one glGen*(n, ids) and, unless
+    // deletions are deferred anyway, one glDelete*(n, ids)
+    void generate(object_t type, GLsizei n, GLuint *ids) {
+      helper::gen_objects(type, n, ids);
+      for (GLsizei i = 0; i < n; ++i)
+        handles.created(type, ids[i]);
     }
     
-    static void delete_render_buffer(GLuint id) {
-      glDeleteRenderbuffers(1, &id);
+    void release(object_t type, GLsizei n, const GLuint *ids) {
+      for (GLsizei i = 0; i < n; ++i) {
+        handles.destroyed(type, ids[i]);
+        state.forget(type, ids[i]);
+        memory.forget(type, ids[i]);
+      }
+      if (deletions.is_deferred()) {
+        for (GLsizei i = 0; i < n; ++i)
+          deletions.push(type, ids[i]);
+      } else
+        helper::delete_objects(type, n, ids);
     }
     
-    static void delete_texture(GLuint id) {
-      glDeleteTextures(1, &id);
+    void end_frame() {
+      deletions.flush();
+      for (helper::name_pool_t &pool: pools)
+        pool.top_up();
     }
     
-    static void delete_program(GLuint id) {
-      glDeleteProgram(id);
+    // Deletes the queued names and every name still pooled for reuse.
+    // Must run while the GL context is current; later releases are
+    // deleted immediately.
+    void shutdown() {
+      deletions.set_deferred(false);
+      for (helper::name_pool_t &pool: pools)
+        pool.clear();
+      state.invalidate();
+    }
+  };
+  
+  namespace helper {
+    inline context_t*& current_context() {
+      static thread_local context_t fallback;
+      static thread_local context_t *current = &fallback;
+      return current;
+    }
+  }
+  
+  inline context_t& context() {
+    return *helper::current_context();
+  }
+  
+  inline void make_current(context_t &ctx) {
+    helper::current_context() = &ctx;
+  }
+  
+  inline GLuint generate(object_t type) {
+    return context().generate(type);
+  }
+  
+  inline void bind_buffer(GLenum target, GLuint id) {
+    context().state.bind_buffer(target, id);
+  }
+  
+  inline void bind_vertex_array(GLuint id) {
+    context().state.bind_vertex_array(id);
+  }
+  
+  inline void use_program(GLuint id) {
+    context().state.use_program(id);
+  }
+  
+  inline void end_frame() {
+    context().end_frame();
+  }
+  
+  inline void shutdown() {
+    context().shutdown();
+  }
+  
+  namespace helper {
+    // Approximate bytes per texel for a texture or renderbuffer format
+    static std::size_t texel_bytes(GLenum format) {
+      switch (format) {
+        case GL_R8: case GL_R8I: case GL_R8UI: case GL_R8_SNORM: case GL_RED: case GL_STENCIL_INDEX8:
+          return 1;
+        case GL_RG8: case GL_RG8I: case GL_RG8UI: case GL_R16: case GL_R16F: case GL_R16I: case GL_R16UI: case GL_RG:
+        case GL_DEPTH_COMPONENT16: case GL_RGB5_A1: case GL_RGBA4: case GL_RGB565:
+          return 2;
+        case GL_RGB8: case GL_SRGB8: case GL_RGB: case GL_RGB8I: case GL_RGB8UI:
+          return 3;
+        case GL_RGB16F: case GL_RGB16: case GL_RGB16I: case GL_RGB16UI:
+          return 6;
+        case GL_RGBA16: case GL_RGBA16F: case GL_RGBA16I: case GL_RGBA16UI:
+        case GL_RG32F: case GL_RG32I: case GL_RG32UI: case GL_DEPTH32F_STENCIL8:
+          return 8;
+        case GL_RGB32F: case GL_RGB32I: case GL_RGB32UI:
+          return 12;
+        case GL_RGBA32F: case GL_RGBA32I: case GL_RGBA32UI:
+          return 16;
+        default:
+          // RGBA8, sRGB8_A8, RGB10_A2, R11F_G11F_B10F, 24/32-bit depth...
+          return 4;
+      }
+    }
+  }
+  
+  // Binds buffer to target, specifies its storage and records its size
+  inline void buffer_data(GLuint buffer, GLenum target, GLsizeiptr size, const void *data, GLenum usage, const char *category = nullptr) {
+    bind_buffer(target, buffer);
+    glBufferData(target, size, data, usage);
+    context().memory.resize(object_t::buffer, buffer, static_cast<std::size_t>(size), category);
+  }
+  
+  // glTexImage2D on texture, accounting each level and cube face separately
+  inline void texture_image_2d(GLuint texture, GLenum target, GLint level, GLenum internal_format, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data, const char *category = nullptr) {
+    std::size_t face = 0;
+    GLenum bind_target = target;
+    if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z) {
+      face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+      bind_target = GL_TEXTURE_CUBE_MAP;
     }
+    glBindTexture(bind_target, texture);
+    glTexImage2D(target, level, static_cast<GLint>(internal_format), width, height, 0, format, type, data);
+    std::size_t bytes = static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * helper::texel_bytes(internal_format);
+    context().memory.resize_image(object_t::texture, texture, static_cast<std::size_t>(level) * 6 + face, bytes, category);
   }
   
-  template <typename T> class ptr_t  {
-    T ptr;
+  inline void render_buffer_storage(GLuint render_buffer, GLenum internal_format, GLsizei width, GLsizei height, GLsizei samples = 0, const char *category = nullptr) {
+    glBindRenderbuffer(GL_RENDERBUFFER, render_buffer);
+    if (samples > 0)
+      glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internal_format, width, height);
+    else
+      glRenderbufferStorage(GL_RENDERBUFFER, internal_format, width, height);
+    std::size_t bytes = static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * helper::texel_bytes(internal_format) * static_cast<std::size_t>(samples > 0 ? samples : 1);
+    context().memory.resize(object_t::render_buffer, render_buffer, bytes, category);
+  }
+  
+  // Owns one GL name. Move-only and exactly the size of a GLuint: a move
+  // copies the name and zeroes the source, so std::vector relocates handles
+  // with plain noexcept moves and a moved-from handle releases nothing.
+  template<object_t Type> class handle_t {
+    GLuint id = 0;
     
   protected:
-    void set(GLuint id) {
-      ptr.reset();
-      ptr = T(id);
+    void set(GLuint name) {
+      reset(name);
     }
     
   public:
-    ptr_t<T>() {}
-    ptr_t<T>(const ptr_t<T> &id) {
-      ptr = std::move(id);
+    static const object_t type = Type;
+    
+    handle_t() noexcept {}
+    explicit handle_t(GLuint name): id(name) {
+      if (name)
+        context().handles.created(Type, name);
     }
-    ptr_t<T>(const GLuint &id) {
-      ptr = T(id);
+    handle_t(const handle_t&) = delete;
+    handle_t& operator =(const handle_t&) = delete;
+    
+    handle_t(handle_t &&other) noexcept: id(other.id) {
+      other.id = 0;
     }
     
-    ptr_t<T>& operator =(GLuint id) {
-      ptr.reset();
-      ptr = T(id);
+    handle_t& operator =(handle_t &&other) noexcept {
+      if (this != &other) {
+        reset();
+        id = other.id;
+        other.id = 0;
+      }
       return *this;
     }
     
-    T& operator ()(GLuint id) {
-      ptr.reset();
-      ptr = T(id);
-      return ptr;
+    ~handle_t() {
+      reset();
     }
     
-    operator GLuint() {
-      return ptr.get();
+    // Releases the current name (if any) and takes ownership of name
+    void reset(GLuint name = 0) {
+      if (name == id)
+        return;
+      if (id)
+        context().release(Type, id);
+      if (name)
+        context().handles.created(Type, name);
+      id = name;
+    }
+    
+    // Gives up ownership without deleting
+    GLuint release() noexcept {
+      GLuint name = id;
+      id = 0;
+      return name;
+    }
+    
+    GLuint get() const noexcept {
+      return id;
+    }
+    
+    operator GLuint() const noexcept {
+      return id;
+    }
+    
+    explicit operator bool() const noexcept {
+      return id != 0;
     }
   };
   
-  using buffer_t = ptr_t<std::unique_ptr<GLuint, helper::ptr_deleter_t<helper::delete_buffer_array>>>;
+  template<object_t Type> const object_t handle_t<Type>::type;
+  
+  using buffer_t = handle_t<object_t::buffer>;
   class vertex_buffer_t: public buffer_t{};
   class element_buffer_t: public buffer_t{};
-  using frame_buffer_t = ptr_t<std::unique_ptr<GLuint, helper::ptr_deleter_t<helper::delete_frame_buffer>>>;
-  using render_buffer_t = ptr_t<std::unique_ptr<GLuint, helper::ptr_deleter_t<helper::delete_render_buffer>>>;
-  using vertex_array_t = ptr_t<std::unique_ptr<GLuint, helper::ptr_deleter_t<helper::delete_vertex_array>>>;
-  using texture_t = ptr_t<std::unique_ptr<GLuint, helper::ptr_deleter_t<helper::delete_texture>>>;
-  using shader_t = ptr_t<std::unique_ptr<GLuint, helper::ptr_deleter_t<helper::delete_program>>>;
+  using frame_buffer_t = handle_t<object_t::frame_buffer>;
+  using render_buffer_t = handle_t<object_t::render_buffer>;
+  using vertex_array_t = handle_t<object_t::vertex_array>;
+  using texture_t = handle_t<object_t::texture>;
+  using shader_t = handle_t<object_t::program>;
+  using query_t = handle_t<object_t::query>;
+  
+  static_assert(sizeof(buffer_t) == sizeof(GLuint) && sizeof(vertex_buffer_t) == sizeof(GLuint), "handles must be a bare GLuint");
+  static_assert(std::is_standard_layout<buffer_t>::value, "handles must be a bare GLuint");
+  static_assert(std::is_nothrow_move_constructible<buffer_t>::value && std::is_nothrow_move_assignable<buffer_t>::value, "handles must move without throwing");
+  static_assert(!std::is_copy_constructible<buffer_t>::value && !std::is_copy_assignable<buffer_t>::value, "handles must not be copyable");
+  
+  // N names of one handle type, generated together with a single glGen*
+  // by generate() and deleted together with a single glDelete*.
+  template<typename T, std::size_t N> class array_t {
+    static_assert(N > 0, "array_t needs at least one name");
+    
+    GLuint ids[N] = {};
+    
+  public:
+    array_t() noexcept {}
+    array_t(const array_t&) = delete;
+    array_t& operator =(const array_t&) = delete;
+    
+    array_t(array_t &&other) noexcept {
+      std::memcpy(ids, other.ids, sizeof ids);
+      std::memset(other.ids, 0, sizeof other.ids);
+    }
+    
+    array_t& operator =(array_t &&other) noexcept {
+      if (this != &other) {
+        reset();
+        std::memcpy(ids, other.ids, sizeof ids);
+        std::memset(other.ids, 0, sizeof other.ids);
+      }
+      return *this;
+    }
+    
+    ~array_t() {
+      reset();
+    }
+    
+    void generate() {
+      reset();
+      context().generate(T::type, static_cast<GLsizei>(N), ids);
+    }
+    
+    // Releases the current names (if any) and takes ownership of the N
+    // names in block, e.g. from a raw glGen*. Names in both are kept.
+    void reset(const GLuint *block = nullptr) {
+      GLuint stale[N];
+      GLsizei n = 0;
+      for (GLuint id: ids)
+        if (id && (!block || std::find(block, block + N, id) == block + N))
+          stale[n++] = id;
+      if (n)
+        context().release(T::type, n, stale);
+      if (block) {
+        for (std::size_t i = 0; i < N; ++i)
+          if (std::find(ids, ids + N, block[i]) == ids + N)
+            context().handles.created(T::type, block[i]);
+        std::memcpy(ids, block, sizeof ids);
+      } else
+        std::memset(ids, 0, sizeof ids);
+    }
+    
+    static constexpr std::size_t size() {
+      return N;
+    }
+    
+    GLuint operator [](std::size_t i) const noexcept {
+      return ids[i];
+    }
+    
+    const GLuint* data() const noexcept {
+      return ids;
+    }
+    
+    const GLuint* begin() const noexcept {
+      return ids;
+    }
+    
+    const GLuint* end() const noexcept {
+      return ids + N;
+    }
+  };
+  
+  // Growable counterpart of array_t. Each generate(n) appends n names with
+  // one glGen*; reset() deletes every name with one glDelete*.
+  template<typename T> class handle_vector_t {
+    std::vector<GLuint> ids;
+    
+  public:
+    handle_vector_t() {}
+    explicit handle_vector_t(std::size_t n) {
+      generate(n);
+    }
+    handle_vector_t(const handle_vector_t&) = delete;
+    handle_vector_t& operator =(const handle_vector_t&) = delete;
+    handle_vector_t(handle_vector_t &&other) noexcept: ids(std::move(other.ids)) {
+      other.ids.clear();
+    }
+    
+    handle_vector_t& operator =(handle_vector_t &&other) noexcept {
+      if (this != &other) {
+        reset();
+        ids.swap(other.ids);
+      }
+      return *this;
+    }
+    
+    ~handle_vector_t() {
+      reset();
+    }
+    
+    void generate(std::size_t n) {
+      if (!n)
+        return;
+      std::size_t first = ids.size();
+      ids.resize(first + n);
+      context().generate(T::type, static_cast<GLsizei>(n), ids.data() + first);
+    }
+    
+    // Releases the current names (if any) and takes ownership of the n
+    // names in block. Names in both are kept.
+    void reset(const GLuint *block = nullptr, std::size_t n = 0) {
+      std::vector<GLuint> kept(block, block ? block + n : block);
+      std::sort(kept.begin(), kept.end());
+      std::vector<GLuint> stale;
+      for (GLuint id: ids)
+        if (!std::binary_search(kept.begin(), kept.end(), id))
+          stale.push_back(id);
+      if (!stale.empty())
+        context().release(T::type, static_cast<GLsizei>(stale.size()), stale.data());
+      std::sort(ids.begin(), ids.end());
+      for (GLuint id: kept)
+        if (!std::binary_search(ids.begin(), ids.end(), id))
+          context().handles.created(T::type, id);
+      ids.assign(block, block ? block + n : block);
+    }
+    
+    std::size_t size() const noexcept {
+      return ids.size();
+    }
+    
+    bool empty() const noexcept {
+      return ids.empty();
+    }
+    
+    GLuint operator [](std::size_t i) const noexcept {
+      return ids[i];
+    }
+    
+    const GLuint* data() const noexcept {
+      return ids.data();
+    }
+    
+    std::vector<GLuint>::const_iterator begin() const noexcept {
+      return ids.begin();
+    }
+    
+    std::vector<GLuint>::const_iterator end() const noexcept {
+      return ids.end();
+    }
+  };
+  
+  namespace helper {
+    struct sync_deleter_t {
+      void operator()(GLsync sync) { glDeleteSync(sync); }
+    };
+  }
+  
+  class sync_t {
+    std::unique_ptr<std::remove_pointer<GLsync>::type, helper::sync_deleter_t> ptr;
+    
+  public:
+    sync_t() {}
+    explicit sync_t(GLsync sync): ptr(sync) {}
+    
+    static sync_t fence() {
+      return sync_t(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    }
+    
+    void reset(GLsync sync = nullptr) {
+      ptr.reset(sync);
+    }
+    
+    bool signaled() const {
+      if (!ptr)
+        return true;
+      GLint status = GL_UNSIGNALED;
+      glGetSynciv(ptr.get(), GL_SYNC_STATUS, 1, nullptr, &status);
+      return status == GL_SIGNALED;
+    }
+    
+    // Blocks until the fence has passed or timeout nanoseconds elapse,
+    // flushing first so the fence is guaranteed to reach the GPU.
+    bool wait(GLuint64 timeout = GL_TIMEOUT_IGNORED) const {
+      if (!ptr)
+        return true;
+      GLenum result = glClientWaitSync(ptr.get(), GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+      return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+    }
+    
+    void gpu_wait() const {
+      if (ptr)
+        glWaitSync(ptr.get(), 0, GL_TIMEOUT_IGNORED);
+    }
+    
+    explicit operator bool() const {
+      return static_cast<bool>(ptr);
+    }
+    
+    operator GLsync() const {
+      return ptr.get();
+    }
+  };
+  
+  // Keeps at most N frames queued on the GPU. end_frame() fences the frame
+  // just submitted and only blocks when the frame N behind it is still
+  // running, instead of draining the pipeline with glFinish.
+  class frame_pacer_t {
+    std::vector<sync_t> frames;
+    std::size_t current = 0;
+    
+  public:
+    explicit frame_pacer_t(std::size_t frames_in_flight = 2): frames(frames_in_flight ? frames_in_flight : 1) {}
+    
+    void end_frame() {
+      frames[current] = sync_t::fence();
+      current = (current + 1) % frames.size();
+      frames[current].wait();
+      frames[current].reset();
+    }
+    
+    // Slot of the frame being recorded, for picking per-frame resources
+    std::size_t index() const {
+      return current;
+    }
+    
+    std::size_t frames_in_flight() const {
+      return frames.size();
+    }
+  };
 }
 
+namespace gl {
+  namespace helper {
+    static int bit_scan_reverse(std::uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+      return 63 - __builtin_clzll(v);
+#else
+      int bit = 0;
+      while (v >>= 1)
+        ++bit;
+      return bit;
+#endif
+    }
+    
+    static int bit_scan_forward(std::uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+      return __builtin_ctzll(v);
+#else
+      int bit = 0;
+      while (!(v & 1)) {
+        v >>= 1;
+        ++bit;
+      }
+      return bit;
+#endif
+    }
+    
+    // Two-level segregated fit allocator over an abstract range of units.
+    // It only keeps bookkeeping, so the same code can carve up any GL
+    // buffer. Allocation and release are O(1); the index returned by
+    // allocate() identifies the block until it is released and survives
+    // compact().
+    class tlsf_t {
+    public:
+      static const std::uint32_t invalid = 0xFFFFFFFFu;
+      
+    private:
+      enum {
+        sl_log2 = 4,
+        sl_count = 1 << sl_log2,
+        fl_count = 64 - sl_log2 + 1
+      };
+      
+      struct block_t {
+        std::uint64_t offset, size;
+        std::uint32_t prev_phys, next_phys;
+        std::uint32_t prev_free, next_free;
+        bool free;
+      };
+      
+      std::vector<block_t> blocks;
+      std::vector<std::uint32_t> spare;
+      std::uint64_t fl_bitmap = 0;
+      std::uint32_t sl_bitmap[fl_count];
+      std::uint32_t heads[fl_count][sl_count];
+      std::uint32_t first = invalid;
+      std::uint64_t capacity_units = 0, used_units = 0;
+      std::size_t live_count = 0, free_count = 0;
+      
+      static void mapping(std::uint64_t size, int &fl, int &sl) {
+        if (size < sl_count) {
+          fl = 0;
+          sl = static_cast<int>(size);
+          return;
+        }
+        int f = bit_scan_reverse(size);
+        sl = static_cast<int>(size >> (f - sl_log2)) ^ sl_count;
+        fl = f - sl_log2 + 1;
+      }
+      
+      static void mapping_search(std::uint64_t size, int &fl, int &sl) {
+        if (size >= sl_count)
+          size += (std::uint64_t(1) << (bit_scan_reverse(size) - sl_log2)) - 1;
+        mapping(size, fl, sl);
+      }
+      
+      void reset_lists() {
+        fl_bitmap = 0;
+        free_count = 0;
+        for (int i = 0; i < fl_count; ++i) {
+          sl_bitmap[i] = 0;
+          for (int j = 0; j < sl_count; ++j)
+            heads[i][j] = invalid;
+        }
+      }
+      
+      std::uint32_t new_record() {
+        if (!spare.empty()) {
+          std::uint32_t i = spare.back();
+          spare.pop_back();
+          return i;
+        }
+        blocks.push_back(block_t());
+        return static_cast<std::uint32_t>(blocks.size() - 1);
+      }
+      
+      // Spare records count as free so a stale index to one is not
+      // mistaken for a live block
+      void retire(std::uint32_t i) {
+        blocks[i].free = true;
+        blocks[i].size = 0;
+        blocks[i].prev_phys = blocks[i].next_phys = invalid;
+        spare.push_back(i);
+      }
+      
+      void insert_free(std::uint32_t i) {
+        int fl, sl;
+        mapping(blocks[i].size, fl, sl);
+        std::uint32_t head = heads[fl][sl];
+        blocks[i].free = true;
+        blocks[i].prev_free = invalid;
+        blocks[i].next_free = head;
+        if (head != invalid)
+          blocks[head].prev_free = i;
+        heads[fl][sl] = i;
+        sl_bitmap[fl] |= 1u << sl;
+        fl_bitmap |= std::uint64_t(1) << fl;
+        ++free_count;
+      }
+      
+      void remove_free(std::uint32_t i) {
+        int fl, sl;
+        mapping(blocks[i].size, fl, sl);
+        std::uint32_t prev = blocks[i].prev_free, next = blocks[i].next_free;
+        if (prev != invalid)
+          blocks[prev].next_free = next;
+        else
+          heads[fl][sl] = next;
+        if (next != invalid)
+          blocks[next].prev_free = prev;
+        if (heads[fl][sl] == invalid) {
+          sl_bitmap[fl] &= ~(1u << sl);
+          if (!sl_bitmap[fl])
+            fl_bitmap &= ~(std::uint64_t(1) << fl);
+        }
+        blocks[i].free = false;
+        --free_count;
+      }
+      
+      std::uint32_t find(int fl, int sl) const {
+        std::uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+        if (!sl_map) {
+          std::uint64_t fl_map = fl + 1 < 64 ? fl_bitmap & (~std::uint64_t(0) << (fl + 1)) : 0;
+          if (!fl_map)
+            return invalid;
+          fl = bit_scan_forward(fl_map);
+          sl_map = sl_bitmap[fl];
+        }
+        return heads[fl][bit_scan_forward(sl_map)];
+      }
+      
+    public:
+      explicit tlsf_t(std::uint64_t units = 0) {
+        reset(units);
+      }
+      
+      void reset(std::uint64_t units) {
+        blocks.clear();
+        spare.clear();
+        reset_lists();
+        capacity_units = units;
+        used_units = 0;
+        live_count = 0;
+        first = invalid;
+        if (!units)
+          return;
+        first = new_record();
+        blocks[first] = block_t{0, units, invalid, invalid, invalid, invalid, true};
+        insert_free(first);
+      }
+      
+      // Smallest free block that allocate(units) is certain to find; the
+      // search rounds requests up to the next size class
+      static std::uint64_t fit(std::uint64_t units) {
+        if (units < sl_count)
+          return units;
+        std::uint64_t step = std::uint64_t(1) << (bit_scan_reverse(units) - sl_log2);
+        return (units + step - 1) & ~(step - 1);
+      }
+      
+      std::uint32_t allocate(std::uint64_t units) {
+        if (!units)
+          return invalid;
+        int fl, sl;
+        mapping_search(units, fl, sl);
+        if (fl >= fl_count)
+          return invalid;
+        std::uint32_t i = find(fl, sl);
+        if (i == invalid)
+          return invalid;
+        remove_free(i);
+        if (blocks[i].size > units) {
+          std::uint32_t rest = new_record();
+          blocks[rest] = block_t{blocks[i].offset + units, blocks[i].size - units, i, blocks[i].next_phys, invalid, invalid, true};
+          if (blocks[rest].next_phys != invalid)
+            blocks[blocks[rest].next_phys].prev_phys = rest;
+          blocks[i].next_phys = rest;
+          blocks[i].size = units;
+          insert_free(rest);
+        }
+        used_units += units;
+        ++live_count;
+        return i;
+      }
+      
+      // Only indices returned by allocate() and not yet freed are live;
+      // anything else (a second free, or a record merged away) is rejected
+      void free(std::uint32_t i) {
+        assert(i < blocks.size() && !blocks[i].free && "tlsf_t: block is not allocated");
+        if (i >= blocks.size() || blocks[i].free)
+          return;
+        used_units -= blocks[i].size;
+        --live_count;
+        std::uint32_t prev = blocks[i].prev_phys;
+        if (prev != invalid && blocks[prev].free) {
+          remove_free(prev);
+          blocks[prev].size += blocks[i].size;
+          blocks[prev].next_phys = blocks[i].next_phys;
+          if (blocks[i].next_phys != invalid)
+            blocks[blocks[i].next_phys].prev_phys = prev;
+          retire(i);
+          i = prev;
+        }
+        std::uint32_t next = blocks[i].next_phys;
+        if (next != invalid && blocks[next].free) {
+          remove_free(next);
+          blocks[i].size += blocks[next].size;
+          blocks[i].next_phys = blocks[next].next_phys;
+          if (blocks[next].next_phys != invalid)
+            blocks[blocks[next].next_phys].prev_phys = i;
+          retire(next);
+        }
+        insert_free(i);
+      }
+      
+      // Slides every live block down to close the gaps between them,
+      // calling move(from, to, size) for each one in address order.
+      template<typename F> void compact(F move) {
+        std::uint64_t cursor = 0;
+        std::uint32_t prev = invalid, head = invalid;
+        reset_lists();
+        for (std::uint32_t i = first; i != invalid;) {
+          std::uint32_t next = blocks[i].next_phys;
+          if (blocks[i].free)
+            retire(i);
+          else {
+            move(blocks[i].offset, cursor, blocks[i].size);
+            blocks[i].offset = cursor;
+            cursor += blocks[i].size;
+            blocks[i].prev_phys = prev;
+            if (prev != invalid)
+              blocks[prev].next_phys = i;
+            else
+              head = i;
+            prev = i;
+          }
+          i = next;
+        }
+        if (prev != invalid)
+          blocks[prev].next_phys = invalid;
+        if (cursor < capacity_units) {
+          std::uint32_t rest = new_record();
+          blocks[rest] = block_t{cursor, capacity_units - cursor, prev, invalid, invalid, invalid, true};
+          if (prev != invalid)
+            blocks[prev].next_phys = rest;
+          else
+            head = rest;
+          insert_free(rest);
+        }
+        first = head;
+      }
+      
+      std::uint64_t offset(std::uint32_t i) const {
+        return blocks[i].offset;
+      }
+      
+      std::uint64_t size(std::uint32_t i) const {
+        return blocks[i].size;
+      }
+      
+      std::uint64_t capacity() const {
+        return capacity_units;
+      }
+      
+      std::uint64_t used() const {
+        return used_units;
+      }
+      
+      std::size_t allocations() const {
+        return live_count;
+      }
+      
+      std::size_t free_blocks() const {
+        return free_count;
+      }
+      
+      std::uint64_t largest_free() const {
+        if (!fl_bitmap)
+          return 0;
+        int fl = bit_scan_reverse(fl_bitmap);
+        std::uint64_t largest = 0;
+        for (std::uint32_t i = heads[fl][bit_scan_reverse(sl_bitmap[fl])]; i != invalid; i = blocks[i].next_free)
+          if (blocks[i].size > largest)
+            largest = blocks[i].size;
+        return largest;
+      }
+    };
+  }
+  
+  struct buffer_range_t {
+    std::uint32_t page = helper::tlsf_t::invalid;
+    std::uint32_t block = helper::tlsf_t::invalid;
+    
+    explicit operator bool() const {
+      return page != helper::tlsf_t::invalid && block != helper::tlsf_t::invalid;
+    }
+  };
+  
+  // Carves many small ranges out of a few large buffer_t pages so meshes
+  // can share buffers (and vertex arrays) instead of owning one each.
+  class buffer_allocator_t {
+    struct page_t {
+      buffer_t buffer;
+      helper::tlsf_t blocks;
+    };
+    
+    std::vector<std::unique_ptr<page_t>> pages;
+    GLsizeiptr page_size, alignment;
+    GLenum usage;
+    
+    std::uint64_t units(GLsizeiptr bytes) const {
+      return static_cast<std::uint64_t>((bytes + alignment - 1) / alignment);
+    }
+    
+    page_t& add_page(GLsizeiptr bytes) {
+      std::uint64_t n = helper::tlsf_t::fit(units(bytes > page_size ? bytes : page_size));
+      pages.emplace_back(new page_t());
+      page_t &page = *pages.back();
+      page.buffer.reset(generate(object_t::buffer));
+      page.blocks.reset(n);
+      buffer_data(page.buffer, GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(n) * alignment, nullptr, usage, "buffer_allocator");
+      return page;
+    }
+    
+  public:
+    struct stats_t {
+      GLsizeiptr capacity = 0, used = 0, largest_free = 0;
+      std::size_t pages = 0, allocations = 0, free_blocks = 0;
+      
+      // 0 when all free space is one block, approaching 1 as it splinters
+      float fragmentation() const {
+        GLsizeiptr free = capacity - used;
+        return free > 0 ? 1.f - static_cast<float>(largest_free) / static_cast<float>(free) : 0.f;
+      }
+    };
+    
+    buffer_allocator_t(GLsizeiptr page_size = GLsizeiptr(1) << 26, GLsizeiptr alignment = 256, GLenum usage = GL_STATIC_DRAW): page_size(page_size), alignment(alignment > 0 ? alignment : 1), usage(usage) {}
+    buffer_allocator_t(const buffer_allocator_t&) = delete;
+    buffer_allocator_t& operator =(const buffer_allocator_t&) = delete;
+    
+    buffer_range_t allocate(GLsizeiptr bytes) {
+      buffer_range_t range;
+      if (bytes <= 0)
+        return range;
+      std::uint64_t n = units(bytes);
+      for (std::size_t i = 0; i < pages.size(); ++i) {
+        std::uint32_t block = pages[i]->blocks.allocate(n);
+        if (block != helper::tlsf_t::invalid) {
+          range.page = static_cast<std::uint32_t>(i);
+          range.block = block;
+          return range;
+        }
+      }
+      page_t &page = add_page(bytes);
+      std::uint32_t block = page.blocks.allocate(n);
+      if (block == helper::tlsf_t::invalid)
+        return buffer_range_t();
+      range.page = static_cast<std::uint32_t>(pages.size() - 1);
+      range.block = block;
+      return range;
+    }
+    
+    void free(buffer_range_t range) {
+      if (range)
+        pages[range.page]->blocks.free(range.block);
+    }
+    
+    GLuint buffer(buffer_range_t range) const {
+      return pages[range.page]->buffer;
+    }
+    
+    GLintptr offset(buffer_range_t range) const {
+      return static_cast<GLintptr>(pages[range.page]->blocks.offset(range.block)) * alignment;
+    }
+    
+    GLsizeiptr size(buffer_range_t range) const {
+      return static_cast<GLsizeiptr>(pages[range.page]->blocks.size(range.block)) * alignment;
+    }
+    
+    void upload(buffer_range_t range, const void *data, GLsizeiptr bytes, GLintptr at = 0) {
+      bind_buffer(GL_COPY_WRITE_BUFFER, buffer(range));
+      glBufferSubData(GL_COPY_WRITE_BUFFER, offset(range) + at, bytes, data);
+    }
+    
+    stats_t stats() const {
+      stats_t out;
+      out.pages = pages.size();
+      for (const std::unique_ptr<page_t> &page: pages) {
+        out.capacity += static_cast<GLsizeiptr>(page->blocks.capacity()) * alignment;
+        out.used += static_cast<GLsizeiptr>(page->blocks.used()) * alignment;
+        out.allocations += page->blocks.allocations();
+        out.free_blocks += page->blocks.free_blocks();
+        GLsizeiptr largest = static_cast<GLsizeiptr>(page->blocks.largest_free()) * alignment;
+        if (largest > out.largest_free)
+          out.largest_free = largest;
+      }
+      return out;
+    }
+    
+    // Packs the live ranges of every fragmented page into a fresh buffer.
+    // Ranges keep their handles but their offsets change, and a compacted
+    // page is backed by a new buffer name, so anything that captured
+    // buffer()/offset() (vertex arrays, cached draws) must be rebuilt
+    // when this returns non-zero. Returns the number of bytes moved.
+    GLsizeiptr defragment() {
+      GLsizeiptr moved = 0;
+      for (std::unique_ptr<page_t> &page: pages) {
+        if (page->blocks.free_blocks() <= 1)
+          continue;
+        GLuint fresh = generate(object_t::buffer);
+        bind_buffer(GL_COPY_READ_BUFFER, page->buffer);
+        buffer_data(fresh, GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(page->blocks.capacity()) * alignment, nullptr, usage, "buffer_allocator");
+        GLintptr run_from = 0, run_to = 0;
+        GLsizeiptr run_size = 0;
+        page->blocks.compact([&](std::uint64_t from, std::uint64_t to, std::uint64_t n) {
+          GLintptr src = static_cast<GLintptr>(from) * alignment, dst = static_cast<GLintptr>(to) * alignment;
+          GLsizeiptr bytes = static_cast<GLsizeiptr>(n) * alignment;
+          if (src != dst)
+            moved += bytes;
+          if (run_size && run_from + run_size == src && run_to + run_size == dst) {
+            run_size += bytes;
+            return;
+          }
+          if (run_size)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, run_from, run_to, run_size);
+          run_from = src;
+          run_to = dst;
+          run_size = bytes;
+        });
+        if (run_size)
+          glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, run_from, run_to, run_size);
+        page->buffer.reset(fresh);
+      }
+      return moved;
+    }
+  };
+}
+
+#ifdef GLAD_DEBUG
+namespace gl {
+  namespace helper {
+    // glad has a single pre/post callback pair, shared by debug_output_t,
+    // call_tracer_t and call_stats_t. Each pushes a layer over the state
+    // found before the first one (null / -1 fields keep the value from
+    // below) and glad runs the combination of every layer, so layers can
+    // be removed in any order. Anything the app set on glad behind the
+    // layers' back becomes the state restored at the end, and pop()
+    // leaves it in place.
+    class glad_hooks_t {
+      struct layer_t {
+        const void *owner;
+        GLADcallback pre, post;
+        int debug;
+      };
+      
+      std::vector<layer_t> layers;
+      layer_t base = layer_t{nullptr, nullptr, nullptr, 1};
+      layer_t applied = layer_t{nullptr, nullptr, nullptr, 1};
+      
+      layer_t combined() const {
+        layer_t out = base;
+        for (const layer_t &layer: layers) {
+          if (layer.pre)
+            out.pre = layer.pre;
+          if (layer.post)
+            out.post = layer.post;
+          if (layer.debug >= 0)
+            out.debug = layer.debug;
+        }
+        return out;
+      }
+      
+      // Sets every field still holding what the layers last applied and
+      // adopts the others as the base
+      void apply() {
+        layer_t current = layer_t{nullptr, glad_get_pre_callback(), glad_get_post_callback(), glad_get_debug()};
+        bool pre = current.pre == applied.pre, post = current.post == applied.post, debug = current.debug == applied.debug;
+        if (!pre)
+          base.pre = current.pre;
+        if (!post)
+          base.post = current.post;
+        if (!debug)
+          base.debug = current.debug;
+        applied = combined();
+        if (pre)
+          glad_set_pre_callback(applied.pre);
+        else
+          applied.pre = current.pre;
+        if (post)
+          glad_set_post_callback(applied.post);
+        else
+          applied.post = current.post;
+        if (debug)
+          glad_set_debug(applied.debug);
+        else
+          applied.debug = current.debug;
+      }
+      
+    public:
+      void push(const void *owner, GLADcallback pre, GLADcallback post, int debug = -1) {
+        if (layers.empty()) {
+          base = layer_t{nullptr, glad_get_pre_callback(), glad_get_post_callback(), glad_get_debug()};
+          applied = base;
+        }
+        layer_t layer = layer_t{owner, pre, post, debug};
+        auto found = std::find_if(layers.begin(), layers.end(), [owner](const layer_t &l) { return l.owner == owner; });
+        if (found != layers.end())
+          *found = layer;
+        else
+          layers.push_back(layer);
+        apply();
+        // A new layer wins over whatever the app had set
+        layer_t top = combined();
+        if (pre)
+          glad_set_pre_callback(applied.pre = top.pre);
+        if (post)
+          glad_set_post_callback(applied.post = top.post);
+        if (debug >= 0)
+          glad_set_debug(applied.debug = top.debug);
+      }
+      
+      void pop(const void *owner) {
+        auto found = std::find_if(layers.begin(), layers.end(), [owner](const layer_t &l) { return l.owner == owner; });
+        if (found == layers.end())
+          return;
+        layers.erase(found);
+        apply();
+      }
+    };
+    
+    inline glad_hooks_t& glad_hooks() {
+      static glad_hooks_t hooks;
+      return hooks;
+    }
+    
+    inline void ignore_call(const char*, void*, int, ...) {}
+  }
+}
+#endif
+
+#ifdef GL_DEBUG_OUTPUT
+namespace gl {
+  struct debug_message_t {
+    GLenum source, type, severity;
+    GLuint id;
+    char text[256];
+  };
+  
+  // Receives GL_KHR_debug / GL 4.3 debug messages and queues them so they
+  // can be drained from any thread. Once installed the per-call
+  // glGetError() check of the glad debug loader is switched off.
+  class debug_output_t {
+    helper::ring_t<debug_message_t, 1024> messages;
+    std::atomic<std::size_t> dropped_count;
+    bool installed = false;
+    GLboolean was_enabled = GL_FALSE;
+    void *previous_callback = nullptr;
+    void *previous_user = nullptr;
+    
+    static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *user) {
+      debug_output_t *self = static_cast<debug_output_t*>(const_cast<void*>(user));
+      debug_message_t msg;
+      msg.source = source;
+      msg.type = type;
+      msg.severity = severity;
+      msg.id = id;
+      std::size_t n = length < 0 ? std::strlen(message) : static_cast<std::size_t>(length);
+      if (n >= sizeof msg.text)
+        n = sizeof msg.text - 1;
+      std::memcpy(msg.text, message, n);
+      msg.text[n] = '\0';
+      if (!self->messages.push(msg))
+        self->dropped_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+  public:
+    debug_output_t(): dropped_count(0) {}
+    debug_output_t(const debug_output_t&) = delete;
+    debug_output_t& operator =(const debug_output_t&) = delete;
+    
+    // The driver holds a pointer to this object while installed
+    ~debug_output_t() {
+      uninstall();
+    }
+    
+    bool install(bool notifications = false) {
+      if (!helper::has_version(4, 3) && !helper::has_extension("GL_KHR_debug"))
+        return false;
+      if (!installed) {
+        was_enabled = glIsEnabled(GL_DEBUG_OUTPUT);
+        glGetPointerv(GL_DEBUG_CALLBACK_FUNCTION, &previous_callback);
+        glGetPointerv(GL_DEBUG_CALLBACK_USER_PARAM, &previous_user);
+      }
+      glEnable(GL_DEBUG_OUTPUT);
+      glDebugMessageCallback(&callback, this);
+      glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, notifications ? GL_TRUE : GL_FALSE);
+#ifdef GLAD_DEBUG
+      helper::glad_hooks().push(this, nullptr, &helper::ignore_call);
+#endif
+      installed = true;
+      return true;
+    }
+    
+    // Puts back the debug callback and GL_DEBUG_OUTPUT state found by
+    // install(), unless the app has replaced the callback since, and gives
+    // glad back its glGetError check
+    void uninstall() {
+      if (!installed)
+        return;
+      void *current = nullptr, *user = nullptr;
+      glGetPointerv(GL_DEBUG_CALLBACK_FUNCTION, &current);
+      glGetPointerv(GL_DEBUG_CALLBACK_USER_PARAM, &user);
+      if (current == reinterpret_cast<void*>(&callback) && user == this) {
+        glDebugMessageCallback(reinterpret_cast<GLDEBUGPROC>(previous_callback), previous_user);
+        if (!was_enabled)
+          glDisable(GL_DEBUG_OUTPUT);
+      }
+#ifdef GLAD_DEBUG
+      helper::glad_hooks().pop(this);
+#endif
+      installed = false;
+    }
+    
+    bool poll(debug_message_t &msg) {
+      return messages.pop(msg);
+    }
+    
+    std::size_t dropped() const {
+      return dropped_count.load(std::memory_order_relaxed);
+    }
+  };
+}
+#endif
+
+#ifdef GL_MAP_PERSISTENT_BIT
+namespace gl {
+  // Persistently mapped buffer split into equally sized regions that are
+  // filled round-robin, one per frame. Retiring a region drops a fence
+  // behind it and a region is only handed out again once its fence has
+  // signalled, so the CPU never writes memory the GPU is still reading.
+  class stream_buffer_t: public buffer_t {
+    GLenum target = GL_ARRAY_BUFFER;
+    GLsizeiptr region_size = 0;
+    GLsizei region_count = 0;
+    GLsizei current = 0;
+    GLsizeiptr cursor = 0;
+    unsigned char *mapped = nullptr;
+    std::vector<sync_t> fences;
+    
+    static const GLbitfield storage_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    
+  public:
+    stream_buffer_t() {}
+    stream_buffer_t(const stream_buffer_t&) = delete;
+    stream_buffer_t& operator =(const stream_buffer_t&) = delete;
+    
+    bool create(GLenum buffer_target, GLsizeiptr bytes_per_region, GLsizei regions = 3) {
+      if (!helper::has_version(4, 4) && !helper::has_extension("GL_ARB_buffer_storage"))
+        return false;
+      // Regions start where glBindBufferRange on buffer_target accepts
+      // them; other targets use the uniform buffer alignment
+      GLenum alignment_query = GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT;
+#ifdef GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+      if (buffer_target == GL_SHADER_STORAGE_BUFFER)
+        alignment_query = GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT;
+#endif
+#ifdef GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT
+      if (buffer_target == GL_TEXTURE_BUFFER)
+        alignment_query = GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT;
+#endif
+      GLint alignment = 1;
+      glGetIntegerv(alignment_query, &alignment);
+      if (alignment < 1)
+        alignment = 1;
+      target = buffer_target;
+      region_count = regions > 0 ? regions : 1;
+      region_size = (bytes_per_region + alignment - 1) / alignment * alignment;
+      GLsizeiptr total = region_size * region_count;
+      reset(generate(object_t::buffer));
+      bind_buffer(target, *this);
+      glBufferStorage(target, total, nullptr, storage_flags);
+      context().memory.resize(object_t::buffer, *this, static_cast<std::size_t>(total), "stream_buffer");
+      mapped = static_cast<unsigned char*>(glMapBufferRange(target, 0, total, storage_flags));
+      fences.clear();
+      fences.resize(static_cast<std::size_t>(region_count));
+      current = 0;
+      cursor = 0;
+      return mapped != nullptr;
+    }
+    
+    // Reserves bytes in the current region and returns where to write them.
+    // offset receives the position inside the whole buffer for use with
+    // glBindBufferRange or as a draw call's base offset.
+    void* allocate(GLsizeiptr bytes, GLintptr &offset, GLsizeiptr alignment = 4) {
+      GLsizeiptr start = (cursor + alignment - 1) / alignment * alignment;
+      if (!mapped || start + bytes > region_size)
+        return nullptr;
+      cursor = start + bytes;
+      offset = current * region_size + start;
+      return mapped + offset;
+    }
+    
+    // Fences the region written this frame and moves on to the next one,
+    // blocking only if the GPU has not finished with it yet.
+    void end_frame() {
+      if (!mapped)
+        return;
+      fences[static_cast<std::size_t>(current)] = sync_t::fence();
+      current = (current + 1) % region_count;
+      cursor = 0;
+      sync_t &next = fences[static_cast<std::size_t>(current)];
+      next.wait();
+      next.reset();
+    }
+    
+    GLenum buffer_target() const {
+      return target;
+    }
+    
+    GLsizeiptr capacity() const {
+      return region_size;
+    }
+    
+    GLsizeiptr used() const {
+      return cursor;
+    }
+  };
+}
+#endif
+
+namespace gl {
+  // Stores linked programs on disk with glGetProgramBinary and restores
+  // them with glProgramBinary. Keys cover the sources with their stages,
+  // defines and the driver strings, and anything the driver refuses to
+  // load is treated as a miss so the caller just compiles from source
+  // again. The directory is created on the first store.
+  class program_cache_t {
+    struct header_t {
+      char magic[4];
+      std::uint32_t version;
+      std::uint64_t key;
+      std::uint32_t format;
+      std::uint32_t length;
+    };
+    
+    std::string directory;
+    std::uint64_t driver = 0;
+    int supported = -1;
+    
+    std::string path(std::uint64_t key) const {
+      char name[17];
+      std::snprintf(name, sizeof name, "%016llx", static_cast<unsigned long long>(key));
+      return directory + "/" + name + ".bin";
+    }
+    
+  public:
+    explicit program_cache_t(std::string directory): directory(std::move(directory)) {}
+    
+    bool available() {
+      if (supported < 0) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0;
+        driver = helper::hash_string(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+        driver = helper::hash_string(reinterpret_cast<const char*>(glGetString(GL_RENDERER)), driver);
+        driver = helper::hash_string(reinterpret_cast<const char*>(glGetString(GL_VERSION)), driver);
+      }
+      return supported > 0;
+    }
+    
+    // types holds each source's shader stage, or is null for sources
+    // whose stage is implied by their position
+    std::uint64_t key(const char *const *sources, const GLenum *types, std::size_t count, const char *defines = nullptr) {
+      available();
+      std::uint64_t hash = helper::hash_string(defines, driver);
+      for (std::size_t i = 0; i < count; ++i) {
+        if (types)
+          hash = helper::hash_bytes(&types[i], sizeof types[i], hash);
+        hash = helper::hash_string(sources[i], hash);
+      }
+      return hash;
+    }
+    
+    // Must be called on a program before it is linked for store() to work
+    void prepare(GLuint program) {
+      if (available())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    
+    GLuint load(std::uint64_t key) {
+      if (!available())
+        return 0;
+      std::FILE *file = std::fopen(path(key).c_str(), "rb");
+      if (!file)
+        return 0;
+      header_t header;
+      std::vector<char> binary;
+      bool ok = std::fread(&header, sizeof header, 1, file) == 1 &&
+                !std::memcmp(header.magic, "GLPB", 4) && header.version == 1 && header.key == key;
+      // A truncated or corrupt entry is a miss, not a huge allocation
+      if (ok) {
+        long start = std::ftell(file);
+        ok = start >= 0 && !std::fseek(file, 0, SEEK_END);
+        long end = ok ? std::ftell(file) : -1;
+        ok = ok && end - start == static_cast<long>(header.length) && !std::fseek(file, start, SEEK_SET);
+      }
+      if (ok) {
+        binary.resize(header.length);
+        ok = header.length && std::fread(binary.data(), 1, binary.size(), file) == binary.size();
+      }
+      std::fclose(file);
+      if (!ok)
+        return 0;
+      GLuint program = generate(object_t::program);
+      glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+      GLint linked = GL_FALSE;
+      glGetProgramiv(program, GL_LINK_STATUS, &linked);
+      if (!linked) {
+        context().release(object_t::program, program);
+        return 0;
+      }
+      return program;
+    }
+    
+    bool store(std::uint64_t key, GLuint program) {
+      if (!available())
+        return false;
+      GLint length = 0;
+      glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+      if (length <= 0)
+        return false;
+      header_t header = {{'G', 'L', 'P', 'B'}, 1, key, 0, 0};
+      std::vector<char> binary(static_cast<std::size_t>(length));
+      GLsizei written = 0;
+      glGetProgramBinary(program, length, &written, &header.format, binary.data());
+      if (written <= 0)
+        return false;
+#if defined(_WIN32)
+      _mkdir(directory.c_str());
+#else
+      mkdir(directory.c_str(), 0755);
+#endif
+      header.length = static_cast<std::uint32_t>(written);
+      std::FILE *file = std::fopen(path(key).c_str(), "wb");
+      if (!file)
+        return false;
+      bool ok = std::fwrite(&header, sizeof header, 1, file) == 1 &&
+                std::fwrite(binary.data(), 1, header.length, file) == header.length;
+      std::fclose(file);
+      return ok;
+    }
+  };
+}
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace gl {
+  struct shader_source_t {
+    GLenum type;
+    const char *source;
+  };
+  
+  // Future-like handle for a program submitted to shader_compiler_t.
+  // Nothing here asks the driver for compile or link status until the
+  // work has finished in the background (GL_KHR_parallel_shader_compile)
+  // or the caller explicitly waits.
+  class pending_program_t {
+    friend class shader_compiler_t;
+    
+    GLuint program = 0;
+    std::vector<GLuint> shaders;
+    bool parallel = false, done = false, linked = false;
+    std::string log;
+    program_cache_t *cache = nullptr;
+    std::uint64_t key = 0;
+    
+    static void append_log(std::string &out, GLint length, bool shader, GLuint id) {
+      if (length <= 1)
+        return;
+      std::vector<char> text(static_cast<std::size_t>(length));
+      if (shader)
+        glGetShaderInfoLog(id, length, nullptr, text.data());
+      else
+        glGetProgramInfoLog(id, length, nullptr, text.data());
+      out += text.data();
+    }
+    
+    void finish() {
+      done = true;
+      GLint status = GL_FALSE;
+      glGetProgramiv(program, GL_LINK_STATUS, &status);
+      linked = status == GL_TRUE;
+      if (!linked) {
+        for (GLuint shader: shaders) {
+          GLint length = 0;
+          glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+          glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+          if (!status)
+            append_log(log, length, true, shader);
+        }
+        GLint length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        append_log(log, length, false, program);
+      }
+      release_shaders();
+      if (!linked) {
+        context().release(object_t::program, program);
+        program = 0;
+      } else if (cache)
+        cache->store(key, program);
+    }
+    
+    void release_shaders() {
+      for (GLuint shader: shaders) {
+        glDetachShader(program, shader);
+        glDeleteShader(shader);
+      }
+      shaders.clear();
+    }
+    
+    void discard() {
+      release_shaders();
+      if (program)
+        context().release(object_t::program, program);
+      program = 0;
+    }
+    
+  public:
+    pending_program_t() {}
+    pending_program_t(const pending_program_t&) = delete;
+    pending_program_t& operator =(const pending_program_t&) = delete;
+    
+    pending_program_t(pending_program_t &&other) noexcept {
+      *this = std::move(other);
+    }
+    
+    pending_program_t& operator =(pending_program_t &&other) noexcept {
+      if (this != &other) {
+        discard();
+        program = other.program;
+        shaders = std::move(other.shaders);
+        parallel = other.parallel;
+        done = other.done;
+        linked = other.linked;
+        log = std::move(other.log);
+        cache = other.cache;
+        key = other.key;
+        other.program = 0;
+        other.shaders.clear();
+      }
+      return *this;
+    }
+    
+    ~pending_program_t() {
+      discard();
+    }
+    
+    // Non-blocking when parallel compilation is available; returns true
+    // once the program has either linked or failed.
+    bool poll() {
+      if (done)
+        return true;
+      if (parallel) {
+        GLint complete = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+        if (!complete)
+          return false;
+      }
+      finish();
+      return true;
+    }
+    
+    GLuint wait() {
+      if (!done)
+        finish();
+      return linked ? program : 0;
+    }
+    
+    bool ready() const {
+      return done && linked;
+    }
+    
+    bool failed() const {
+      return done && !linked;
+    }
+    
+    const std::string& error() const {
+      return log;
+    }
+    
+    // Hands the linked program over to the caller, e.g. shader_t::set()
+    GLuint release() {
+      GLuint out = ready() ? program : 0;
+      if (out)
+        program = 0;
+      return out;
+    }
+  };
+  
+  class shader_compiler_t {
+    int parallel = -1;
+    
+  public:
+    bool parallel_supported() {
+      if (parallel < 0) {
+        parallel = helper::has_extension("GL_KHR_parallel_shader_compile") || helper::has_extension("GL_ARB_parallel_shader_compile");
+#if defined(__glad_h_) && defined(GL_ARB_parallel_shader_compile)
+        if (parallel && GLAD_GL_ARB_parallel_shader_compile)
+          glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+#endif
+      }
+      return parallel > 0;
+    }
+    
+    // Issues every compile and the link without waiting on any of them.
+    // With a cache, a hit comes back already linked and a miss is stored
+    // once it finishes.
+    pending_program_t submit(std::initializer_list<shader_source_t> stages, program_cache_t *cache = nullptr) {
+      pending_program_t pending;
+      pending.parallel = parallel_supported();
+      if (cache) {
+        std::vector<const char*> sources;
+        std::vector<GLenum> types;
+        for (const shader_source_t &stage: stages) {
+          sources.push_back(stage.source);
+          types.push_back(stage.type);
+        }
+        pending.key = cache->key(sources.data(), types.data(), sources.size());
+        if (GLuint program = cache->load(pending.key)) {
+          pending.program = program;
+          pending.done = pending.linked = true;
+          return pending;
+        }
+        pending.cache = cache;
+      }
+      pending.program = generate(object_t::program);
+      if (cache)
+        cache->prepare(pending.program);
+      for (const shader_source_t &stage: stages) {
+        GLuint shader = glCreateShader(stage.type);
+        glShaderSource(shader, 1, &stage.source, nullptr);
+        glCompileShader(shader);
+        glAttachShader(pending.program, shader);
+        pending.shaders.push_back(shader);
+      }
+      glLinkProgram(pending.program);
+      return pending;
+    }
+  };
+}
+
+namespace gl {
+  enum attrib_flag_t {
+    normalized = 1,
+    integer = 2
+  };
+  
+  namespace helper {
+    template<typename T> struct gl_type;
+    template<> struct gl_type<std::int8_t> { static constexpr GLenum value = GL_BYTE; };
+    template<> struct gl_type<std::uint8_t> { static constexpr GLenum value = GL_UNSIGNED_BYTE; };
+    template<> struct gl_type<std::int16_t> { static constexpr GLenum value = GL_SHORT; };
+    template<> struct gl_type<std::uint16_t> { static constexpr GLenum value = GL_UNSIGNED_SHORT; };
+    template<> struct gl_type<std::int32_t> { static constexpr GLenum value = GL_INT; };
+    template<> struct gl_type<std::uint32_t> { static constexpr GLenum value = GL_UNSIGNED_INT; };
+    template<> struct gl_type<float> { static constexpr GLenum value = GL_FLOAT; };
+    template<> struct gl_type<double> { static constexpr GLenum value = GL_DOUBLE; };
+    
+    static constexpr std::size_t size_sum() {
+      return 0;
+    }
+    
+    template<typename... R> static constexpr std::size_t size_sum(std::size_t first, R... rest) {
+      return first + size_sum(rest...);
+    }
+    
+    enum attrib_kind_t {
+      float_attrib,
+      integer_attrib,
+      double_attrib
+    };
+    
+    inline void attrib_pointer(std::integral_constant<int, float_attrib>, GLuint location, GLint components, GLenum type, GLboolean normalize, GLsizei stride, std::size_t offset) {
+      glVertexAttribPointer(location, components, type, normalize, stride, reinterpret_cast<const void*>(offset));
+    }
+    
+    inline void attrib_pointer(std::integral_constant<int, integer_attrib>, GLuint location, GLint components, GLenum type, GLboolean, GLsizei stride, std::size_t offset) {
+      glVertexAttribIPointer(location, components, type, stride, reinterpret_cast<const void*>(offset));
+    }
+    
+    inline void attrib_pointer(std::integral_constant<int, double_attrib>, GLuint location, GLint components, GLenum type, GLboolean, GLsizei stride, std::size_t offset) {
+      glVertexAttribLPointer(location, components, type, stride, reinterpret_cast<const void*>(offset));
+    }
+    
+#ifdef GL_VERSION_4_3
+    inline void attrib_format(std::integral_constant<int, float_attrib>, GLuint location, GLint components, GLenum type, GLboolean normalize, std::size_t offset) {
+      glVertexAttribFormat(location, components, type, normalize, static_cast<GLuint>(offset));
+    }
+    
+    inline void attrib_format(std::integral_constant<int, integer_attrib>, GLuint location, GLint components, GLenum type, GLboolean, std::size_t offset) {
+      glVertexAttribIFormat(location, components, type, static_cast<GLuint>(offset));
+    }
+    
+    inline void attrib_format(std::integral_constant<int, double_attrib>, GLuint location, GLint components, GLenum type, GLboolean, std::size_t offset) {
+      glVertexAttribLFormat(location, components, type, static_cast<GLuint>(offset));
+    }
+#endif
+  }
+  
+  // One vertex attribute: N components of T. Flags select normalized
+  // fixed point (float in the shader) or integer (ivec/uvec) fetches.
+  template<typename T, GLint N, unsigned Flags = 0> struct attrib {
+    static_assert(N >= 1 && N <= 4, "attrib must have between 1 and 4 components");
+    static_assert(!((Flags & normalized) && (Flags & integer)), "attrib cannot be both normalized and integer");
+    static_assert(!(Flags & integer) || std::is_integral<T>::value, "integer attrib needs an integral type");
+    
+    typedef T type;
+    static constexpr GLint components = N;
+    static constexpr GLenum gl_type = helper::gl_type<T>::value;
+    static constexpr GLboolean normalize = (Flags & normalized) ? GL_TRUE : GL_FALSE;
+    static constexpr int kind = (Flags & integer) ? helper::integer_attrib : std::is_same<T, double>::value ? helper::double_attrib : helper::float_attrib;
+    static constexpr std::size_t size = sizeof(T) * N;
+  };
+  
+  // Interleaved vertex format resolved entirely at compile time. apply()
+  // expands to one glVertexAttrib*Pointer and glEnableVertexAttribArray
+  // per attribute for the bound vertex array and GL_ARRAY_BUFFER.
+  template<typename... A> struct vertex_layout {
+    static_assert(sizeof...(A) > 0, "vertex_layout needs at least one attrib");
+    
+    static constexpr std::size_t count = sizeof...(A);
+    
+    static constexpr std::size_t offset(std::size_t index) {
+      const std::size_t sizes[] = { A::size... };
+      std::size_t total = 0;
+      for (std::size_t i = 0; i < index; ++i)
+        total += sizes[i];
+      return total;
+    }
+    
+    static constexpr GLsizei stride = static_cast<GLsizei>(helper::size_sum(A::size...));
+    
+    // Identifies the format (types, counts, flags and offsets) for caching
+    static constexpr std::uint64_t hash() {
+      const std::uint64_t parts[] = { (std::uint64_t(A::gl_type) << 32) | (std::uint64_t(A::components) << 8) | (std::uint64_t(A::kind) << 4) | A::normalize... };
+      std::uint64_t h = 14695981039346656037ull;
+      for (std::size_t i = 0; i < sizeof...(A); ++i) {
+        h = (h ^ parts[i]) * 1099511628211ull;
+        h = (h ^ offset(i)) * 1099511628211ull;
+      }
+      return h;
+    }
+    
+  private:
+    template<typename Attr> static void setup(GLuint location, std::size_t at, std::size_t base) {
+      helper::attrib_pointer(std::integral_constant<int, Attr::kind>(), location, Attr::components, Attr::gl_type, Attr::normalize, stride, base + at);
+      glEnableVertexAttribArray(location);
+    }
+    
+    template<std::size_t... I> static void apply(GLuint first_location, std::size_t base, std::index_sequence<I...>) {
+      int expand[] = { (setup<A>(first_location + static_cast<GLuint>(I), offset(I), base), 0)... };
+      (void)expand;
+    }
+    
+#ifdef GL_VERSION_4_3
+    template<typename Attr> static void setup_format(GLuint location, std::size_t at, GLuint binding) {
+      helper::attrib_format(std::integral_constant<int, Attr::kind>(), location, Attr::components, Attr::gl_type, Attr::normalize, at);
+      glVertexAttribBinding(location, binding);
+      glEnableVertexAttribArray(location);
+    }
+    
+    template<std::size_t... I> static void apply_format(GLuint first_location, GLuint binding, std::index_sequence<I...>) {
+      int expand[] = { (setup_format<A>(first_location + static_cast<GLuint>(I), offset(I), binding), 0)... };
+      (void)expand;
+    }
+#endif
+    
+  public:
+    static void apply(GLuint first_location = 0, std::size_t base = 0) {
+      apply(first_location, base, std::index_sequence_for<A...>());
+    }
+    
+#ifdef GL_VERSION_4_3
+    // Separate attribute format (GL 4.3): describes the layout on the bound
+    // vertex array without tying it to a buffer, which is then attached
+    // with glBindVertexBuffer(binding, ...).
+    static void apply_format(GLuint first_location = 0, GLuint binding = 0) {
+      apply_format(first_location, binding, std::index_sequence_for<A...>());
+    }
+#endif
+  };
+  
+  template<typename... A> constexpr std::size_t vertex_layout<A...>::count;
+  template<typename... A> constexpr GLsizei vertex_layout<A...>::stride;
+}
+
+namespace gl {
+  // Shares vertex arrays between meshes with the same layout. With
+  // separate attribute formats (GL 4.3 / ARB_vertex_attrib_binding) one
+  // vertex array per layout is kept and buffers are swapped in with
+  // glBindVertexBuffer; otherwise a vertex array is built once per
+  // layout and buffer combination. Call evict() before deleting a buffer
+  // that has been bound through the cache, as its name may be reused.
+  class vertex_array_cache_t {
+    struct key_t {
+      std::uint64_t layout;
+      GLuint vertex_buffer, element_buffer;
+      GLintptr offset;
+      
+      bool operator ==(const key_t &other) const {
+        return layout == other.layout && vertex_buffer == other.vertex_buffer && element_buffer == other.element_buffer && offset == other.offset;
+      }
+    };
+    
+    struct key_hash_t {
+      std::size_t operator()(const key_t &key) const {
+        return static_cast<std::size_t>(helper::hash_bytes(&key.offset, sizeof key.offset, helper::hash_bytes(&key.element_buffer, sizeof key.element_buffer, helper::hash_bytes(&key.vertex_buffer, sizeof key.vertex_buffer, key.layout))));
+      }
+    };
+    
+    struct entry_t {
+      vertex_array_t vao;
+      GLuint vertex_buffer = 0;
+      GLintptr offset = -1;
+    };
+    
+    std::unordered_map<key_t, entry_t, key_hash_t> entries;
+    int separate = -1;
+    
+  public:
+    vertex_array_cache_t() {}
+    vertex_array_cache_t(const vertex_array_cache_t&) = delete;
+    vertex_array_cache_t& operator =(const vertex_array_cache_t&) = delete;
+    
+    bool separate_format() {
+#ifdef GL_VERSION_4_3
+      if (separate < 0)
+        separate = helper::has_version(4, 3) || helper::has_extension("GL_ARB_vertex_attrib_binding");
+      return separate > 0;
+#else
+      return false;
+#endif
+    }
+    
+    // Binds a vertex array describing Layout over the given buffers and
+    // returns it. offset is the byte offset of the first vertex.
+    template<typename Layout> GLuint bind(GLuint vertex_buffer, GLuint element_buffer = 0, GLintptr offset = 0) {
+#ifdef GL_VERSION_4_3
+      if (separate_format()) {
+        entry_t &entry = entries[key_t{Layout::hash(), 0, 0, 0}];
+        if (!entry.vao) {
+          entry.vao.reset(generate(object_t::vertex_array));
+          bind_vertex_array(entry.vao);
+          Layout::apply_format();
+        } else
+          bind_vertex_array(entry.vao);
+        if (entry.vertex_buffer != vertex_buffer || entry.offset != offset) {
+          glBindVertexBuffer(0, vertex_buffer, offset, Layout::stride);
+          entry.vertex_buffer = vertex_buffer;
+          entry.offset = offset;
+        }
+        bind_buffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer);
+        return entry.vao;
+      }
+#endif
+      entry_t &entry = entries[key_t{Layout::hash(), vertex_buffer, element_buffer, offset}];
+      if (!entry.vao) {
+        entry.vao.reset(generate(object_t::vertex_array));
+        bind_vertex_array(entry.vao);
+        bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+        Layout::apply(0, static_cast<std::size_t>(offset));
+        bind_buffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer);
+      } else
+        bind_vertex_array(entry.vao);
+      return entry.vao;
+    }
+    
+    void evict(GLuint buffer) {
+      for (auto it = entries.begin(); it != entries.end();) {
+        if (it->first.vertex_buffer == buffer || it->first.element_buffer == buffer)
+          it = entries.erase(it);
+        else {
+          if (it->second.vertex_buffer == buffer) {
+            it->second.vertex_buffer = 0;
+            it->second.offset = -1;
+          }
+          ++it;
+        }
+      }
+    }
+    
+    void clear() {
+      entries.clear();
+    }
+    
+    std::size_t size() const {
+      return entries.size();
+    }
+  };
+}
+
+namespace gl {
+  // Compact draw packet replayed by command_bucket_t. index_type of 0
+  // draws arrays from first, otherwise elements starting at byte offset
+  // first. draw_id is free for the caller to index per-draw data with.
+  struct draw_command_t {
+    GLuint program = 0;
+    GLuint vertex_array = 0;
+    GLuint texture = 0;
+    GLenum texture_target = GL_TEXTURE_2D;
+    GLenum mode = GL_TRIANGLES;
+    GLenum index_type = 0;
+    GLsizei count = 0;
+    GLsizei instances = 1;
+    GLintptr first = 0;
+    GLint base_vertex = 0;
+    std::uint32_t draw_id = 0;
+  };
+  
+  // Sort key layout, most significant first: pass (8 bits), program (16),
+  // material (16), depth (24). Sorting by key groups draws by pass, then
+  // by the most expensive state to change.
+  inline std::uint64_t make_sort_key(std::uint32_t pass, std::uint32_t program, std::uint32_t material, std::uint32_t depth) {
+    return (std::uint64_t(pass & 0xFFu) << 56) | (std::uint64_t(program & 0xFFFFu) << 40) | (std::uint64_t(material & 0xFFFFu) << 24) | (depth & 0xFFFFFFu);
+  }
+  
+  // Linear recording buffer owned by a single thread. Recording touches no
+  // GL state, so worker threads can fill their own lists during traversal
+  // and culling while the GL thread merges and replays them.
+  class command_list_t {
+    friend class command_bucket_t;
+    
+    std::vector<std::uint64_t> keys;
+    std::vector<draw_command_t> commands;
+    
+  public:
+    void reserve(std::size_t n) {
+      keys.reserve(n);
+      commands.reserve(n);
+    }
+    
+    void push(std::uint64_t key, const draw_command_t &command) {
+      keys.push_back(key);
+      commands.push_back(command);
+    }
+    
+    // Keeps the capacity so steady-state recording doesn't allocate
+    void clear() {
+      keys.clear();
+      commands.clear();
+    }
+    
+    std::size_t size() const {
+      return commands.size();
+    }
+  };
+  
+  class command_bucket_t {
+  public:
+    typedef void (*draw_callback_t)(const draw_command_t &command, void *user);
+    
+  private:
+    struct item_t {
+      std::uint64_t key;
+      std::uint32_t index;
+    };
+    
+    std::vector<draw_command_t> commands;
+    std::vector<item_t> items, scratch;
+    draw_callback_t callback = nullptr;
+    void *callback_user = nullptr;
+    
+  public:
+    void reserve(std::size_t n) {
+      commands.reserve(n);
+      items.reserve(n);
+      scratch.reserve(n);
+    }
+    
+    void push(std::uint64_t key, const draw_command_t &command) {
+      items.push_back(item_t{key, static_cast<std::uint32_t>(commands.size())});
+      commands.push_back(command);
+    }
+    
+    void append(const command_list_t &list) {
+      std::uint32_t base = static_cast<std::uint32_t>(commands.size());
+      for (std::size_t i = 0; i < list.keys.size(); ++i)
+        items.push_back(item_t{list.keys[i], base + static_cast<std::uint32_t>(i)});
+      commands.insert(commands.end(), list.commands.begin(), list.commands.end());
+    }
+    
+    // Called before every draw on replay, e.g. to upload per-draw uniforms
+    void set_draw_callback(draw_callback_t fn, void *user = nullptr) {
+      callback = fn;
+      callback_user = user;
+    }
+    
+    // Stable LSD radix sort on the keys, one byte per pass. Histograms for
+    // all eight bytes are built in a single sweep and passes whose byte is
+    // the same for every key are skipped.
+    void sort() {
+      std::size_t n = items.size();
+      if (n < 2)
+        return;
+      std::size_t counts[8][256] = {};
+      for (const item_t &item: items)
+        for (int b = 0; b < 8; ++b)
+          ++counts[b][(item.key >> (b * 8)) & 0xFF];
+      scratch.resize(n);
+      for (int b = 0; b < 8; ++b) {
+        std::size_t *count = counts[b];
+        if (count[(items[0].key >> (b * 8)) & 0xFF] == n)
+          continue;
+        std::size_t sum = 0;
+        for (int i = 0; i < 256; ++i) {
+          std::size_t c = count[i];
+          count[i] = sum;
+          sum += c;
+        }
+        for (const item_t &item: items)
+          scratch[count[(item.key >> (b * 8)) & 0xFF]++] = item;
+        items.swap(scratch);
+      }
+    }
+    
+    // Issues the draws in their current order, only touching the program,
+    // vertex array and texture when they differ from the previous draw.
+    void submit() {
+      GLuint texture = 0;
+      GLenum texture_target = 0;
+      if (!items.empty())
+        glActiveTexture(GL_TEXTURE0);
+      for (const item_t &item: items) {
+        const draw_command_t &cmd = commands[item.index];
+        use_program(cmd.program);
+        bind_vertex_array(cmd.vertex_array);
+        if (cmd.texture != texture || cmd.texture_target != texture_target) {
+          glBindTexture(cmd.texture_target, cmd.texture);
+          texture = cmd.texture;
+          texture_target = cmd.texture_target;
+        }
+        if (callback)
+          callback(cmd, callback_user);
+        if (cmd.index_type) {
+          const void *offset = reinterpret_cast<const void*>(cmd.first);
+          if (cmd.instances > 1)
+            glDrawElementsInstancedBaseVertex(cmd.mode, cmd.count, cmd.index_type, offset, cmd.instances, cmd.base_vertex);
+          else
+            glDrawElementsBaseVertex(cmd.mode, cmd.count, cmd.index_type, offset, cmd.base_vertex);
+        } else if (cmd.instances > 1)
+          glDrawArraysInstanced(cmd.mode, static_cast<GLint>(cmd.first), cmd.count, cmd.instances);
+        else
+          glDrawArrays(cmd.mode, static_cast<GLint>(cmd.first), cmd.count);
+      }
+    }
+    
+    void clear() {
+      commands.clear();
+      items.clear();
+    }
+    
+    std::size_t size() const {
+      return items.size();
+    }
+  };
+  
+  // One command list per worker thread, padded so neighbouring lists don't
+  // share a cache line. Workers record into list(i) concurrently; the GL
+  // thread then calls merge() once they have all finished.
+  class command_recorder_t {
+    struct alignas(64) slot_t {
+      command_list_t list;
+    };
+    
+    std::vector<slot_t> slots;
+    
+  public:
+    explicit command_recorder_t(std::size_t threads) : slots(threads) {}
+    
+    command_list_t &list(std::size_t thread) {
+      return slots[thread].list;
+    }
+    
+    std::size_t threads() const {
+      return slots.size();
+    }
+    
+    // Appends every list to bucket in thread order and clears them
+    void merge(command_bucket_t &bucket) {
+      std::size_t total = bucket.size();
+      for (slot_t &slot: slots)
+        total += slot.list.size();
+      bucket.reserve(total);
+      for (slot_t &slot: slots) {
+        bucket.append(slot.list);
+        slot.list.clear();
+      }
+    }
+  };
+}
+
+namespace gl {
+  // Collapses identical draws (same program, vertex array, texture and
+  // index range) into one instanced draw. Each pushed draw contributes one
+  // instance described by Layout, e.g. four vec4 columns for a transform;
+  // instance data is streamed into a single buffer and attached to the
+  // draw's vertex array at first_location onwards with a divisor of 1, so
+  // the vertex arrays must leave those locations free. They are disabled
+  // again after each draw, leaving the vertex arrays as they were.
+  template<typename Layout> class instance_batcher_t {
+    struct key_t {
+      GLuint program, vertex_array, texture;
+      GLenum texture_target, mode, index_type;
+      GLsizei count;
+      GLint base_vertex;
+      GLintptr first;
+      
+      bool operator ==(const key_t &other) const {
+        return std::memcmp(this, &other, sizeof(key_t)) == 0;
+      }
+    };
+    
+    struct key_hash_t {
+      std::size_t operator()(const key_t &key) const {
+        return static_cast<std::size_t>(helper::hash_bytes(&key, sizeof key));
+      }
+    };
+    
+    struct group_t {
+      key_t key;
+      std::vector<unsigned char> instances;
+      GLintptr offset = 0;
+    };
+    
+    std::vector<group_t> groups;
+    std::unordered_map<key_t, std::size_t, key_hash_t> lookup;
+    std::vector<unsigned char> bytes;
+    buffer_t instance_buffer;
+    GLsizeiptr capacity = 0;
+    GLuint location;
+    
+  public:
+    explicit instance_batcher_t(GLuint first_location) : location(first_location) {}
+    instance_batcher_t(const instance_batcher_t&) = delete;
+    instance_batcher_t& operator =(const instance_batcher_t&) = delete;
+    
+    // instance points at Layout::stride bytes of per-instance data
+    void push(const draw_command_t &draw, const void *instance) {
+      key_t key{draw.program, draw.vertex_array, draw.texture, draw.texture_target, draw.mode, draw.index_type, draw.count, draw.base_vertex, draw.first};
+      auto found = lookup.find(key);
+      std::size_t index;
+      if (found == lookup.end()) {
+        index = groups.size();
+        lookup.emplace(key, index);
+        groups.emplace_back();
+        groups.back().key = key;
+      } else
+        index = found->second;
+      const unsigned char *data = static_cast<const unsigned char*>(instance);
+      groups[index].instances.insert(groups[index].instances.end(), data, data + Layout::stride);
+    }
+    
+    template<typename T> void push(const draw_command_t &draw, const T &instance) {
+      static_assert(sizeof(T) == static_cast<std::size_t>(Layout::stride), "instance data doesn't match the layout");
+      push(draw, static_cast<const void*>(&instance));
+    }
+    
+    void submit() {
+      bytes.clear();
+      for (group_t &group: groups) {
+        group.offset = static_cast<GLintptr>(bytes.size());
+        bytes.insert(bytes.end(), group.instances.begin(), group.instances.end());
+      }
+      if (bytes.empty())
+        return;
+      GLsizeiptr size = static_cast<GLsizeiptr>(bytes.size());
+      if (!instance_buffer)
+        instance_buffer.reset(generate(object_t::buffer));
+      if (size > capacity)
+        capacity = size > capacity * 2 ? size : capacity * 2;
+      buffer_data(instance_buffer, GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW, "instance_batcher");
+      glBufferSubData(GL_ARRAY_BUFFER, 0, size, bytes.data());
+      
+      GLuint texture = 0;
+      GLenum texture_target = 0;
+      glActiveTexture(GL_TEXTURE0);
+      for (const group_t &group: groups) {
+        if (group.instances.empty())
+          continue;
+        const key_t &key = group.key;
+        GLsizei instances = static_cast<GLsizei>(group.instances.size() / Layout::stride);
+        use_program(key.program);
+        bind_vertex_array(key.vertex_array);
+        if (key.texture != texture || key.texture_target != texture_target) {
+          glBindTexture(key.texture_target, key.texture);
+          texture = key.texture;
+          texture_target = key.texture_target;
+        }
+        bind_buffer(GL_ARRAY_BUFFER, instance_buffer);
+        Layout::apply(location, static_cast<std::size_t>(group.offset));
+        for (GLuint i = 0; i < Layout::count; ++i)
+          glVertexAttribDivisor(location + i, 1);
+        if (key.index_type)
+          glDrawElementsInstancedBaseVertex(key.mode, key.count, key.index_type, reinterpret_cast<const void*>(key.first), instances, key.base_vertex);
+        else
+          glDrawArraysInstanced(key.mode, static_cast<GLint>(key.first), key.count, instances);
+        for (GLuint i = 0; i < Layout::count; ++i) {
+          glVertexAttribDivisor(location + i, 0);
+          glDisableVertexAttribArray(location + i);
+        }
+      }
+    }
+    
+    // Empties the groups but keeps them and their storage for next frame
+    void clear() {
+      for (group_t &group: groups)
+        group.instances.clear();
+    }
+    
+    std::size_t draws() const {
+      std::size_t n = 0;
+      for (const group_t &group: groups)
+        n += !group.instances.empty();
+      return n;
+    }
+  };
+}
+
+#ifdef GL_VERSION_4_3
+namespace gl {
+  // Layout of one glMultiDrawElementsIndirect record
+  struct draw_elements_indirect_t {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+  };
+  
+  // Packs draws that share a program, vertex array and primitive type into
+  // one glMultiDrawElementsIndirect each. Per-draw data of type T goes into
+  // a shader storage buffer bound at data_binding; shaders fetch their entry
+  // with gl_DrawID, so T must match the std430 layout on the GLSL side.
+  template <typename T> class indirect_batcher_t {
+    static_assert(std::is_trivially_copyable<T>::value, "per-draw data is copied straight into a storage buffer");
+    
+    struct key_t {
+      GLuint program, vertex_array;
+      GLenum mode, index_type;
+      
+      bool operator ==(const key_t &other) const {
+        return program == other.program && vertex_array == other.vertex_array && mode == other.mode && index_type == other.index_type;
+      }
+    };
+    
+    struct key_hash_t {
+      std::size_t operator()(const key_t &key) const {
+        return static_cast<std::size_t>(helper::hash_bytes(&key, sizeof key));
+      }
+    };
+    
+    struct batch_t {
+      key_t key;
+      std::vector<draw_elements_indirect_t> commands;
+      std::vector<T> data;
+      GLintptr command_offset = 0;
+      GLintptr data_offset = 0;
+    };
+    
+    std::vector<batch_t> batches;
+    std::unordered_map<key_t, std::size_t, key_hash_t> lookup;
+    buffer_t command_buffer, data_buffer;
+    GLsizeiptr command_capacity = 0, data_capacity = 0;
+    std::vector<unsigned char> command_bytes, data_bytes;
+    GLuint binding;
+    GLint data_alignment = 0;
+    
+    static void upload(buffer_t &buffer, GLsizeiptr &capacity, GLenum target, const std::vector<unsigned char> &bytes) {
+      GLsizeiptr size = static_cast<GLsizeiptr>(bytes.size());
+      if (!buffer)
+        buffer.reset(generate(object_t::buffer));
+      if (size > capacity)
+        capacity = size > capacity * 2 ? size : capacity * 2;
+      // Orphan so the driver doesn't stall on last frame's draws
+      buffer_data(buffer, target, capacity, nullptr, GL_STREAM_DRAW, "indirect_batcher");
+      glBufferSubData(target, 0, size, bytes.data());
+    }
+    
+  public:
+    explicit indirect_batcher_t(GLuint data_binding = 0) : binding(data_binding) {}
+    indirect_batcher_t(const indirect_batcher_t&) = delete;
+    indirect_batcher_t& operator =(const indirect_batcher_t&) = delete;
+    
+    // gl_DrawID needs GL 4.6 or ARB_shader_draw_parameters on top of MDI
+    static bool supported() {
+      bool indirect = helper::has_version(4, 3) || (helper::has_extension("GL_ARB_multi_draw_indirect") && helper::has_extension("GL_ARB_shader_storage_buffer_object"));
+      return indirect && (helper::has_version(4, 6) || helper::has_extension("GL_ARB_shader_draw_parameters"));
+    }
+    
+    void push(GLuint program, GLuint vertex_array, const draw_elements_indirect_t &command, const T &data, GLenum mode = GL_TRIANGLES, GLenum index_type = GL_UNSIGNED_INT) {
+      key_t key{program, vertex_array, mode, index_type};
+      auto found = lookup.find(key);
+      std::size_t index;
+      if (found == lookup.end()) {
+        index = batches.size();
+        lookup.emplace(key, index);
+        batches.emplace_back();
+        batches.back().key = key;
+      } else
+        index = found->second;
+      batch_t &batch = batches[index];
+      batch.commands.push_back(command);
+      batch.data.push_back(data);
+    }
+    
+    // Uploads every batch's commands and data in one go, then issues one
+    // multi-draw per batch.
+    void submit() {
+      if (!data_alignment) {
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &data_alignment);
+        if (data_alignment < 1)
+          data_alignment = 1;
+      }
+      command_bytes.clear();
+      data_bytes.clear();
+      for (batch_t &batch: batches) {
+        if (batch.commands.empty())
+          continue;
+        batch.command_offset = static_cast<GLintptr>(command_bytes.size());
+        const unsigned char *commands = reinterpret_cast<const unsigned char*>(batch.commands.data());
+        command_bytes.insert(command_bytes.end(), commands, commands + batch.commands.size() * sizeof(draw_elements_indirect_t));
+        std::size_t start = (data_bytes.size() + data_alignment - 1) / data_alignment * data_alignment;
+        batch.data_offset = static_cast<GLintptr>(start);
+        data_bytes.resize(start + batch.data.size() * sizeof(T));
+        std::memcpy(data_bytes.data() + start, batch.data.data(), batch.data.size() * sizeof(T));
+      }
+      if (command_bytes.empty())
+        return;
+      upload(command_buffer, command_capacity, GL_DRAW_INDIRECT_BUFFER, command_bytes);
+      upload(data_buffer, data_capacity, GL_SHADER_STORAGE_BUFFER, data_bytes);
+      for (const batch_t &batch: batches) {
+        if (batch.commands.empty())
+          continue;
+        use_program(batch.key.program);
+        bind_vertex_array(batch.key.vertex_array);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, data_buffer, batch.data_offset, static_cast<GLsizeiptr>(batch.data.size() * sizeof(T)));
+        glMultiDrawElementsIndirect(batch.key.mode, batch.key.index_type, reinterpret_cast<const void*>(batch.command_offset), static_cast<GLsizei>(batch.commands.size()), 0);
+      }
+    }
+    
+    // Empties the batches but keeps them and their storage for next frame
+    void clear() {
+      for (batch_t &batch: batches) {
+        batch.commands.clear();
+        batch.data.clear();
+      }
+    }
+    
+    std::size_t draws() const {
+      std::size_t n = 0;
+      for (const batch_t &batch: batches)
+        n += batch.commands.size();
+      return n;
+    }
+  };
+}
+#endif
+
+namespace gl {
+  // Scoped CPU/GPU profiler. Each scope brackets its region with two
+  // GL_TIMESTAMP queries; frames rotate through a ring of `latency` slots
+  // and a slot is only read back when it comes round again, by which time
+  // the GPU has normally finished with it. A frame whose queries are still
+  // pending is dropped rather than waited on.
+  class gpu_profiler_t {
+  public:
+    // One scope in the timing tree, stored in pre-order. parent is the
+    // index of the enclosing scope or -1.
+    struct node_t {
+      const char *name;
+      int depth;
+      int parent;
+      double cpu_ms;
+      double gpu_ms;
+    };
+    
+    class scope_t {
+      gpu_profiler_t &profiler;
+      
+    public:
+      scope_t(gpu_profiler_t &profiler, const char *name): profiler(profiler) {
+        profiler.begin(name);
+      }
+      ~scope_t() {
+        profiler.end();
+      }
+      scope_t(const scope_t&) = delete;
+      scope_t& operator =(const scope_t&) = delete;
+    };
+    
+  private:
+    typedef std::chrono::steady_clock cpu_clock_t;
+    
+    struct record_t {
+      const char *name;
+      int depth, parent;
+      std::size_t begin_query, end_query;
+      cpu_clock_t::time_point cpu_begin, cpu_end;
+    };
+    
+    struct frame_t {
+      std::vector<query_t> queries;
+      std::vector<record_t> records;
+      std::size_t used = 0;
+    };
+    
+    std::vector<frame_t> frames;
+    std::size_t current = 0;
+    std::vector<int> open;
+    std::vector<node_t> resolved;
+    std::size_t dropped_frames = 0;
+    
+    std::size_t timestamp(frame_t &frame) {
+      if (frame.used == frame.queries.size()) {
+        frame.queries.emplace_back(generate(object_t::query));
+      }
+      std::size_t index = frame.used++;
+      glQueryCounter(frame.queries[index], GL_TIMESTAMP);
+      return index;
+    }
+    
+    // Returns false without blocking if the GPU hasn't caught up yet
+    bool resolve(frame_t &frame) {
+      if (frame.records.empty())
+        return false;
+      GLuint available = 0;
+      glGetQueryObjectuiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+        return false;
+      resolved.clear();
+      for (const record_t &record: frame.records) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(frame.queries[record.begin_query], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.queries[record.end_query], GL_QUERY_RESULT, &end);
+        double cpu = std::chrono::duration<double, std::milli>(record.cpu_end - record.cpu_begin).count();
+        resolved.push_back(node_t{record.name, record.depth, record.parent, cpu, static_cast<double>(end - begin) * 1e-6});
+      }
+      return true;
+    }
+    
+  public:
+    explicit gpu_profiler_t(std::size_t latency = 3): frames(latency > 1 ? latency : 2) {}
+    gpu_profiler_t(const gpu_profiler_t&) = delete;
+    gpu_profiler_t& operator =(const gpu_profiler_t&) = delete;
+    
+    // name must outlive the frame it is read back in; string literals do
+    void begin(const char *name) {
+      frame_t &frame = frames[current];
+      int parent = open.empty() ? -1 : open.back();
+      open.push_back(static_cast<int>(frame.records.size()));
+      record_t record;
+      record.name = name;
+      record.depth = static_cast<int>(open.size()) - 1;
+      record.parent = parent;
+      record.begin_query = timestamp(frame);
+      record.end_query = record.begin_query;
+      record.cpu_begin = cpu_clock_t::now();
+      record.cpu_end = record.cpu_begin;
+      frame.records.push_back(record);
+    }
+    
+    void end() {
+      if (open.empty())
+        return;
+      frame_t &frame = frames[current];
+      record_t &record = frame.records[static_cast<std::size_t>(open.back())];
+      open.pop_back();
+      record.cpu_end = cpu_clock_t::now();
+      record.end_query = timestamp(frame);
+    }
+    
+    // Closes the current frame and reads back the oldest one in the ring
+    void end_frame() {
+      while (!open.empty())
+        end();
+      current = (current + 1) % frames.size();
+      frame_t &oldest = frames[current];
+      if (!oldest.records.empty() && !resolve(oldest))
+        ++dropped_frames;
+      oldest.records.clear();
+      oldest.used = 0;
+    }
+    
+    // Timing tree of the most recently resolved frame
+    const std::vector<node_t>& results() const {
+      return resolved;
+    }
+    
+    std::size_t dropped() const {
+      return dropped_frames;
+    }
+    
+    void print(std::FILE *out = stdout) const {
+      for (const node_t &node: resolved)
+        std::fprintf(out, "%*s%-*s cpu %8.3f ms  gpu %8.3f ms\n", node.depth * 2, "", 32 - node.depth * 2, node.name, node.cpu_ms, node.gpu_ms);
+    }
+  };
+}
+
+#ifdef GLAD_DEBUG
+namespace gl {
+  namespace helper {
+    // Cheapest monotonic counter available; converted to time with a
+    // calibration against steady_clock taken over the trace.
+    inline std::uint64_t trace_ticks() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+      return __rdtsc();
+#else
+      return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+    
+    inline std::uint64_t trace_nanoseconds() {
+      return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    
+    struct trace_event_t {
+      const char *name;
+      std::uint64_t begin, end;
+    };
+    
+    // Written only by its owning thread. count is published with release
+    // ordering so the exporting thread can read completed events without
+    // taking a lock.
+    struct trace_buffer_t {
+      std::unique_ptr<trace_event_t[]> events;
+      std::size_t capacity = 0;
+      std::atomic<std::size_t> count;
+      std::atomic<std::size_t> dropped;
+      std::uint64_t pending = 0;
+      std::uint32_t thread = 0;
+      
+      trace_buffer_t(): count(0), dropped(0) {}
+    };
+    
+    struct trace_state_t {
+      std::mutex lock;
+      std::vector<std::unique_ptr<trace_buffer_t>> buffers;
+      std::size_t capacity = 1 << 16;
+      std::uint64_t start_ticks = 0, start_ns = 0;
+      std::uint64_t stop_ticks = 0, stop_ns = 0;
+      bool active = false;
+    };
+    
+    inline trace_state_t& trace_state() {
+      static trace_state_t state;
+      return state;
+    }
+    
+    // Buffers live until exit so they can be exported after their thread
+    // has gone; only the first call on each thread takes the lock.
+    inline trace_buffer_t& trace_buffer() {
+      static thread_local trace_buffer_t *local = nullptr;
+      if (!local) {
+        trace_state_t &state = trace_state();
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.buffers.emplace_back(new trace_buffer_t());
+        local = state.buffers.back().get();
+        local->thread = static_cast<std::uint32_t>(state.buffers.size());
+        local->capacity = state.capacity;
+        local->events.reset(new trace_event_t[local->capacity]);
+      }
+      return *local;
+    }
+  }
+  
+  // Times every GL call made through the glad debug table and exports the
+  // result as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+  // Tracing owns glad's pre and post callbacks while it runs and stop()
+  // puts back whatever callbacks and table were there before, so start()
+  // and stop() should be called from the GL thread with no other calls in
+  // flight. Each thread records at most `capacity` calls per trace; later
+  // calls are counted as dropped.
+  class call_tracer_t {
+    static void pre_call(const char*, void*, int, ...) {
+      helper::trace_buffer().pending = helper::trace_ticks();
+    }
+    
+    static void post_call(const char *name, void*, int, ...) {
+      std::uint64_t end = helper::trace_ticks();
+      helper::trace_buffer_t &buffer = helper::trace_buffer();
+      std::size_t n = buffer.count.load(std::memory_order_relaxed);
+      if (n == buffer.capacity) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      buffer.events[n] = helper::trace_event_t{name, buffer.pending, end};
+      buffer.count.store(n + 1, std::memory_order_release);
+    }
+    
+    // Nanoseconds per tick over the traced interval
+    static double tick_scale() {
+      helper::trace_state_t &state = helper::trace_state();
+      std::uint64_t ticks = state.active ? helper::trace_ticks() : state.stop_ticks;
+      std::uint64_t ns = state.active ? helper::trace_nanoseconds() : state.stop_ns;
+      if (ticks <= state.start_ticks)
+        return 1.0;
+      return static_cast<double>(ns - state.start_ns) / static_cast<double>(ticks - state.start_ticks);
+    }
+    
+  public:
+    struct function_stats_t {
+      std::string name;
+      std::size_t calls;
+      double total_us, max_us;
+    };
+    
+    static void start(std::size_t capacity = 1 << 16) {
+      helper::trace_state_t &state = helper::trace_state();
+      {
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.capacity = capacity ? capacity : 1;
+        for (auto &buffer: state.buffers) {
+          if (buffer->capacity != state.capacity) {
+            buffer->events.reset(new helper::trace_event_t[state.capacity]);
+            buffer->capacity = state.capacity;
+          }
+          buffer->count.store(0, std::memory_order_relaxed);
+          buffer->dropped.store(0, std::memory_order_relaxed);
+        }
+      }
+      state.start_ns = helper::trace_nanoseconds();
+      state.start_ticks = helper::trace_ticks();
+      state.active = true;
+      helper::glad_hooks().push(&state, &pre_call, &post_call, 1);
+    }
+    
+    static void stop() {
+      helper::trace_state_t &state = helper::trace_state();
+      if (!state.active)
+        return;
+      helper::glad_hooks().pop(&state);
+      state.stop_ticks = helper::trace_ticks();
+      state.stop_ns = helper::trace_nanoseconds();
+      state.active = false;
+    }
+    
+    static std::size_t dropped() {
+      helper::trace_state_t &state = helper::trace_state();
+      std::lock_guard<std::mutex> guard(state.lock);
+      std::size_t n = 0;
+      for (auto &buffer: state.buffers)
+        n += buffer->dropped.load(std::memory_order_relaxed);
+      return n;
+    }
+    
+    // Per-function totals over everything recorded, most expensive first
+    static std::vector<function_stats_t> summary() {
+      helper::trace_state_t &state = helper::trace_state();
+      double scale = tick_scale() * 1e-3;
+      std::unordered_map<std::string, function_stats_t> totals;
+      std::lock_guard<std::mutex> guard(state.lock);
+      for (auto &buffer: state.buffers) {
+        std::size_t n = buffer->count.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < n; ++i) {
+          const helper::trace_event_t &event = buffer->events[i];
+          double us = static_cast<double>(event.end - event.begin) * scale;
+          auto found = totals.find(event.name);
+          if (found == totals.end())
+            found = totals.emplace(event.name, function_stats_t{event.name, 0, 0.0, 0.0}).first;
+          function_stats_t &stats = found->second;
+          ++stats.calls;
+          stats.total_us += us;
+          if (us > stats.max_us)
+            stats.max_us = us;
+        }
+      }
+      std::vector<function_stats_t> result;
+      result.reserve(totals.size());
+      for (auto &entry: totals)
+        result.push_back(entry.second);
+      std::sort(result.begin(), result.end(), [](const function_stats_t &a, const function_stats_t &b) {
+        return a.total_us > b.total_us;
+      });
+      return result;
+    }
+    
+    // Writes a Chrome trace with one complete ("X") event per GL call
+    static bool write_json(const char *path) {
+      std::FILE *file = std::fopen(path, "w");
+      if (!file)
+        return false;
+      helper::trace_state_t &state = helper::trace_state();
+      double scale = tick_scale() * 1e-3;
+      bool first = true;
+      std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+      {
+        std::lock_guard<std::mutex> guard(state.lock);
+        for (auto &buffer: state.buffers) {
+          std::size_t n = buffer->count.load(std::memory_order_acquire);
+          for (std::size_t i = 0; i < n; ++i) {
+            const helper::trace_event_t &event = buffer->events[i];
+            double ts = static_cast<double>(event.begin - state.start_ticks) * scale;
+            double dur = static_cast<double>(event.end - event.begin) * scale;
+            std::fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"gl\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",", event.name, buffer->thread, ts, dur);
+            first = false;
+          }
+        }
+      }
+      std::fprintf(file, "\n]}\n");
+      return std::fclose(file) == 0;
+    }
+  };
+}
+#endif
+
+#if defined(GLAD_DEBUG) && defined(GLAD_FUNCTION_COUNT)
+namespace gl {
+  struct frame_stats_t {
+    std::uint64_t calls;
+    std::uint64_t draws;
+    std::uint64_t binds;
+    std::uint64_t uploads;
+    std::uint64_t bytes_uploaded;
+  };
+  
+  namespace helper {
+    enum call_kind_t : unsigned char {
+      call_other,
+      call_draw,
+      call_bind,
+      call_upload,
+      call_buffer_data,
+      call_buffer_sub_data
+    };
+    
+    struct call_stats_state_t {
+      std::atomic<std::uint64_t> counts[GLAD_FUNCTION_COUNT];
+      unsigned char kinds[GLAD_FUNCTION_COUNT];
+      std::atomic<std::uint64_t> calls, draws, binds, uploads, bytes;
+      frame_stats_t last = frame_stats_t();
+      bool classified = false;
+      bool active = false;
+      
+      call_stats_state_t(): calls(0), draws(0), binds(0), uploads(0), bytes(0) {
+        for (std::atomic<std::uint64_t> &count: counts)
+          count.store(0, std::memory_order_relaxed);
+        std::memset(kinds, 0, sizeof kinds);
+      }
+    };
+    
+    inline call_stats_state_t& call_stats_state() {
+      static call_stats_state_t state;
+      return state;
+    }
+    
+    static bool starts_with(const char *name, const char *prefix) {
+      return std::strncmp(name, prefix, std::strlen(prefix)) == 0;
+    }
+    
+    static unsigned char classify_call(const char *name) {
+      if (!std::strcmp(name, "glBufferData") || !std::strcmp(name, "glNamedBufferData"))
+        return call_buffer_data;
+      if (!std::strcmp(name, "glBufferSubData") || !std::strcmp(name, "glNamedBufferSubData"))
+        return call_buffer_sub_data;
+      if (starts_with(name, "glDraw") || starts_with(name, "glMultiDraw"))
+        return call_draw;
+      if (starts_with(name, "glBind") || !std::strcmp(name, "glUseProgram"))
+        return call_bind;
+      if (starts_with(name, "glTexImage") || starts_with(name, "glTexSubImage") || starts_with(name, "glTextureSubImage") || starts_with(name, "glCompressedTex"))
+        return call_upload;
+      return call_other;
+    }
+  }
+  
+  // Counts every GL call made through the glad debug table. The name glad
+  // passes to the pre-call hook points into glad_function_names, so the
+  // entry point's index is pointer arithmetic and each call costs one or two
+  // relaxed atomic increments. Draw, bind and upload totals (with bytes for
+  // buffer uploads) are kept per frame; per-function counts run from start().
+  // Owns glad's callbacks while enabled, so it can't run alongside
+  // call_tracer_t; stop() restores the callbacks and table it replaced.
+  class call_stats_t {
+    static void pre_call(const char *name, void*, int argc, ...) {
+      helper::call_stats_state_t &state = helper::call_stats_state();
+      int index = glad_function_index(name);
+      if (index < 0 || index >= GLAD_FUNCTION_COUNT)
+        return;
+      state.counts[index].fetch_add(1, std::memory_order_relaxed);
+      state.calls.fetch_add(1, std::memory_order_relaxed);
+      switch (state.kinds[index]) {
+        case helper::call_draw:
+          state.draws.fetch_add(1, std::memory_order_relaxed);
+          break;
+        case helper::call_bind:
+          state.binds.fetch_add(1, std::memory_order_relaxed);
+          break;
+        case helper::call_upload:
+          state.uploads.fetch_add(1, std::memory_order_relaxed);
+          break;
+        case helper::call_buffer_data:
+        case helper::call_buffer_sub_data: {
+          // Target or buffer name first, then the offset for sub-data
+          va_list args;
+          va_start(args, argc);
+          va_arg(args, unsigned int);
+          if (state.kinds[index] == helper::call_buffer_sub_data)
+            va_arg(args, GLintptr);
+          GLsizeiptr size = va_arg(args, GLsizeiptr);
+          va_end(args);
+          state.uploads.fetch_add(1, std::memory_order_relaxed);
+          state.bytes.fetch_add(static_cast<std::uint64_t>(size), std::memory_order_relaxed);
+          break;
+        }
+        default:
+          break;
+      }
+    }
+    
+  public:
+    static void start() {
+      helper::call_stats_state_t &state = helper::call_stats_state();
+      if (!state.classified) {
+        for (int i = 0; i < GLAD_FUNCTION_COUNT; ++i)
+          state.kinds[i] = helper::classify_call(glad_function_names[i]);
+        state.classified = true;
+      }
+      for (std::atomic<std::uint64_t> &count: state.counts)
+        count.store(0, std::memory_order_relaxed);
+      end_frame();
+      state.active = true;
+      helper::glad_hooks().push(&state, &pre_call, &helper::ignore_call, 1);
+    }
+    
+    static void stop() {
+      helper::call_stats_state_t &state = helper::call_stats_state();
+      if (!state.active)
+        return;
+      helper::glad_hooks().pop(&state);
+      state.active = false;
+    }
+    
+    // Returns the totals since the previous end_frame() and starts a new frame
+    static frame_stats_t end_frame() {
+      helper::call_stats_state_t &state = helper::call_stats_state();
+      frame_stats_t frame;
+      frame.calls = state.calls.exchange(0, std::memory_order_relaxed);
+      frame.draws = state.draws.exchange(0, std::memory_order_relaxed);
+      frame.binds = state.binds.exchange(0, std::memory_order_relaxed);
+      frame.uploads = state.uploads.exchange(0, std::memory_order_relaxed);
+      frame.bytes_uploaded = state.bytes.exchange(0, std::memory_order_relaxed);
+      state.last = frame;
+      return frame;
+    }
+    
+    static const frame_stats_t& last_frame() {
+      return helper::call_stats_state().last;
+    }
+    
+    static std::uint64_t calls(int index) {
+      if (index < 0 || index >= GLAD_FUNCTION_COUNT)
+        return 0;
+      return helper::call_stats_state().counts[index].load(std::memory_order_relaxed);
+    }
+    
+    // Prints the `limit` most called entry points since start()
+    static void print(std::FILE *out = stdout, std::size_t limit = 20) {
+      helper::call_stats_state_t &state = helper::call_stats_state();
+      std::vector<std::pair<std::uint64_t, int>> used;
+      for (int i = 0; i < GLAD_FUNCTION_COUNT; ++i) {
+        std::uint64_t n = state.counts[i].load(std::memory_order_relaxed);
+        if (n)
+          used.push_back(std::make_pair(n, i));
+      }
+      std::sort(used.begin(), used.end(), [](const std::pair<std::uint64_t, int> &a, const std::pair<std::uint64_t, int> &b) {
+        return a.first > b.first;
+      });
+      if (used.size() > limit)
+        used.resize(limit);
+      for (const auto &entry: used)
+        std::fprintf(out, "%-40s %12llu\n", glad_function_names[entry.second], static_cast<unsigned long long>(entry.first));
+    }
+  };
+}
+#endif
+
 #endif /* gl_hpp */
@@ -0,0 +1,156 @@
+//
+//  allocator.cpp
+//  opengl_raii
+//
+//  Checks tlsf_t and buffer_allocator_t against a reference model. The GL
+//  entry points the allocator touches are stubbed, so no context is needed:
+//
+//    c++ -std=c++14 -I.. -I../example allocator.cpp ../example/glad.c -ldl
+//
+
+#include "glad.h"
+#include "gl.hpp"
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <random>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      ++failures; \
+    } \
+  } while (0)
+
+static GLuint next_name = 1;
+static std::size_t live_buffers = 0;
+
+static void APIENTRY stub_gen_buffers(GLsizei n, GLuint *ids) {
+  for (GLsizei i = 0; i < n; ++i)
+    ids[i] = next_name++;
+  live_buffers += static_cast<std::size_t>(n);
+}
+
+static void APIENTRY stub_delete_buffers(GLsizei n, const GLuint *ids) {
+  for (GLsizei i = 0; i < n; ++i)
+    if (ids[i])
+      --live_buffers;
+}
+
+static void APIENTRY stub_bind_buffer(GLenum, GLuint) {}
+static void APIENTRY stub_buffer_data(GLenum, GLsizeiptr, const void*, GLenum) {}
+
+// Live blocks by offset; every allocation is checked against its neighbours
+struct model_t {
+  std::map<std::uint64_t, std::pair<std::uint64_t, std::uint32_t>> blocks;
+  std::uint64_t used = 0;
+  
+  bool fits(std::uint64_t offset, std::uint64_t size, std::uint64_t capacity) const {
+    if (offset + size > capacity)
+      return false;
+    auto next = blocks.lower_bound(offset);
+    if (next != blocks.end() && next->first < offset + size)
+      return false;
+    if (next != blocks.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second.first > offset)
+        return false;
+    }
+    return true;
+  }
+};
+
+static void test_tlsf(std::uint32_t seed) {
+  std::mt19937 rng(seed);
+  const std::uint64_t capacity = 1 + rng() % 100000;
+  gl::helper::tlsf_t tlsf(capacity);
+  model_t model;
+  std::vector<std::uint32_t> live;
+  for (int step = 0; step < 20000; ++step) {
+    if (live.empty() || rng() % 3) {
+      std::uint64_t units = 1 + rng() % (rng() % 8 ? 64 : capacity);
+      std::uint32_t i = tlsf.allocate(units);
+      if (i == gl::helper::tlsf_t::invalid)
+        continue;
+      CHECK(tlsf.size(i) == units);
+      CHECK(model.fits(tlsf.offset(i), tlsf.size(i), capacity));
+      model.blocks[tlsf.offset(i)] = std::make_pair(tlsf.size(i), i);
+      model.used += units;
+      live.push_back(i);
+    } else {
+      std::size_t pick = rng() % live.size();
+      std::uint32_t i = live[pick];
+      live[pick] = live.back();
+      live.pop_back();
+      CHECK(model.blocks.count(tlsf.offset(i)) && model.blocks[tlsf.offset(i)].second == i);
+      model.used -= tlsf.size(i);
+      model.blocks.erase(tlsf.offset(i));
+      tlsf.free(i);
+    }
+    if (step % 5000 == 4999) {
+      tlsf.compact([](std::uint64_t, std::uint64_t, std::uint64_t) {});
+      model.blocks.clear();
+      for (std::uint32_t i: live) {
+        CHECK(model.fits(tlsf.offset(i), tlsf.size(i), capacity));
+        model.blocks[tlsf.offset(i)] = std::make_pair(tlsf.size(i), i);
+      }
+      CHECK(tlsf.free_blocks() <= 1);
+    }
+    CHECK(tlsf.used() == model.used);
+    CHECK(tlsf.allocations() == live.size());
+  }
+  for (std::uint32_t i: live)
+    tlsf.free(i);
+  // Everything freed must coalesce back into one block
+  CHECK(tlsf.used() == 0);
+  CHECK(tlsf.allocations() == 0);
+  CHECK(tlsf.free_blocks() == 1);
+  CHECK(tlsf.largest_free() == capacity);
+}
+
+static void test_buffer_allocator() {
+  glad_debug_glGenBuffers = &stub_gen_buffers;
+  glad_debug_glDeleteBuffers = &stub_delete_buffers;
+  glad_debug_glBindBuffer = &stub_bind_buffer;
+  glad_debug_glBufferData = &stub_buffer_data;
+  {
+    gl::buffer_allocator_t allocator(1024, 16);
+    // Larger than a page: the page is sized to fit it
+    gl::buffer_range_t big = allocator.allocate(4000);
+    CHECK(big && allocator.size(big) >= 4000);
+    // Unallocatable sizes fail without adding pages
+    std::size_t pages = allocator.stats().pages;
+    CHECK(!allocator.allocate(0));
+    CHECK(!allocator.allocate(-1));
+    CHECK(allocator.stats().pages == pages);
+    std::mt19937 rng(7);
+    std::vector<gl::buffer_range_t> ranges;
+    for (int i = 0; i < 1000; ++i) {
+      GLsizeiptr bytes = 1 + rng() % 3000;
+      gl::buffer_range_t range = allocator.allocate(bytes);
+      CHECK(range && allocator.size(range) >= bytes && allocator.offset(range) % 16 == 0);
+      ranges.push_back(range);
+    }
+    for (gl::buffer_range_t range: ranges)
+      allocator.free(range);
+    allocator.free(big);
+    gl::buffer_allocator_t::stats_t stats = allocator.stats();
+    CHECK(stats.used == 0 && stats.allocations == 0 && stats.free_blocks == stats.pages);
+  }
+  gl::context().end_frame();
+  CHECK(live_buffers == gl::context().names(gl::object_t::buffer).size());
+}
+
+int main() {
+  for (std::uint32_t seed = 1; seed <= 50; ++seed)
+    test_tlsf(seed);
+  test_buffer_allocator();
+  if (failures)
+    std::fprintf(stderr, "%d checks failed\n", failures);
+  else
+    std::printf("allocator: ok\n");
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}